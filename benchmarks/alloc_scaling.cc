@@ -0,0 +1,416 @@
+// Measures how allocators scale with threads sharing them. Every pattern runs
+// against every allocator at 1, 2, 4, ... up to --threads threads and results
+// are written as JSON: throughput, throughput per thread and scaling
+// efficiency, which is throughput per thread relative to the single thread run.
+//
+//   alloc_scaling [--threads n] [--ops n] [--out file]
+//
+// Patterns:
+//   private            every thread frees its own blocks
+//   producer_consumer  threads in pairs, one allocates and the other frees
+//   all_to_all         every thread sends its blocks to the others in turn
+//
+// Allocators:
+//   malloc             std::malloc and std::free
+//   pool_locked        one pool_allocator behind a mutex
+//   pool_per_thread    pool_allocator per thread behind a mutex of its own,
+//                      blocks are returned to the pool they came from
+//   concurrent_pool    one concurrent_pool_allocator
+//   caching_pool       one caching_pool_allocator, per-thread caches in front
+//                      of a shared concurrent_pool_allocator
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memory/allocators/caching_pool_allocator.h"
+#include "memory/allocators/concurrent_pool_allocator.h"
+#include "memory/allocators/pool_allocator.h"
+
+namespace {
+constexpr std::size_t kBatch = 64;
+// Blocks a mailbox may hold before senders wait for its owner
+constexpr std::size_t kMailboxLimit = 16*kBatch;
+constexpr std::size_t kBlockSize = 16;
+constexpr std::size_t kMaxRequest = 256;
+// Enough for blocks in flight of one thread
+constexpr std::size_t kPoolPerThread = std::size_t(1) << 22;
+
+struct block {
+  uint8_t* ptr;
+  uint32_t size;
+  uint32_t owner;
+};
+
+// Byte allocator shared by benchmark threads. thread is the index of the
+// calling thread, owner the index of the thread that allocated the block.
+class target {
+ public:
+  virtual ~target() = default;
+  virtual uint8_t* allocate(std::size_t size, std::size_t thread) = 0;
+  virtual void deallocate(uint8_t* ptr, std::size_t size, std::size_t owner) = 0;
+};
+
+class malloc_target : public target {
+ public:
+  uint8_t* allocate(std::size_t size, std::size_t) override {
+    void* res = std::malloc(size);
+    if (!res) {
+      throw std::bad_alloc();
+    }
+    return static_cast<uint8_t*>(res);
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t, std::size_t) override {
+    std::free(ptr);
+  }
+};
+
+class locked_pool_target : public target {
+ public:
+  explicit locked_pool_target(std::size_t threads)
+      : al_(threads*kPoolPerThread, kBlockSize) {}
+
+  ~locked_pool_target() noexcept override {}
+
+  uint8_t* allocate(std::size_t size, std::size_t) override {
+    std::lock_guard<std::mutex> guard(lock_);
+    return al_.allocate(size);
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t size, std::size_t) override {
+    std::lock_guard<std::mutex> guard(lock_);
+    al_.deallocate(ptr, size);
+  }
+
+ private:
+  std::mutex lock_;
+  memory::pool_allocator<uint8_t> al_;
+};
+
+class pool_per_thread_target : public target {
+  struct alignas(64) shard {
+    shard() : al(kPoolPerThread, kBlockSize) {}
+    ~shard() noexcept {}
+
+    std::mutex lock;
+    memory::pool_allocator<uint8_t> al;
+  };
+
+ public:
+  explicit pool_per_thread_target(std::size_t threads) : shards_(threads) {}
+
+  uint8_t* allocate(std::size_t size, std::size_t thread) override {
+    shard& s = shards_[thread];
+    std::lock_guard<std::mutex> guard(s.lock);
+    return s.al.allocate(size);
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t size, std::size_t owner) override {
+    shard& s = shards_[owner];
+    std::lock_guard<std::mutex> guard(s.lock);
+    s.al.deallocate(ptr, size);
+  }
+
+ private:
+  std::vector<shard> shards_;
+};
+
+class concurrent_pool_target : public target {
+ public:
+  explicit concurrent_pool_target(std::size_t threads)
+      : al_(threads*kPoolPerThread, kBlockSize) {}
+
+  ~concurrent_pool_target() noexcept override {}
+
+  uint8_t* allocate(std::size_t size, std::size_t) override {
+    return al_.allocate(size);
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t size, std::size_t) override {
+    al_.deallocate(ptr, size);
+  }
+
+ private:
+  memory::concurrent_pool_allocator<uint8_t> al_;
+};
+
+class caching_pool_target : public target {
+ public:
+  explicit caching_pool_target(std::size_t threads) : al_(threads*kPoolPerThread) {}
+
+  ~caching_pool_target() noexcept override {}
+
+  uint8_t* allocate(std::size_t size, std::size_t) override {
+    return al_.allocate(size);
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t size, std::size_t) override {
+    al_.deallocate(ptr, size);
+  }
+
+ private:
+  memory::caching_pool_allocator<uint8_t> al_;
+};
+
+std::unique_ptr<target> make_target(const std::string& name, std::size_t threads) {
+  if (name == "malloc") {
+    return std::make_unique<malloc_target>();
+  } else if (name == "pool_locked") {
+    return std::make_unique<locked_pool_target>(threads);
+  } else if (name == "pool_per_thread") {
+    return std::make_unique<pool_per_thread_target>(threads);
+  } else if (name == "caching_pool") {
+    return std::make_unique<caching_pool_target>(threads);
+  }
+  return std::make_unique<concurrent_pool_target>(threads);
+}
+
+struct alignas(64) mailbox {
+  std::mutex lock;
+  std::vector<block> blocks;
+  // Producer of a producer_consumer pair is done
+  std::atomic<bool> closed{false};
+};
+
+// State shared by threads of one run
+struct run_state {
+  run_state(target& alloc, std::size_t threads, std::size_t ops)
+      : alloc(alloc), threads(threads), ops(ops), boxes(threads), producing(threads) {}
+
+  target& alloc;
+  std::size_t threads;
+  // Allocations per thread
+  std::size_t ops;
+  std::vector<mailbox> boxes;
+  std::atomic<std::size_t> producing;
+  std::atomic<bool> go{false};
+};
+
+// Returns number of allocations
+std::size_t allocate_batch(run_state& s, std::size_t thread, std::mt19937& gen,
+                           std::vector<block>& out) {
+  for (std::size_t i = 0; i < kBatch; ++i) {
+    uint32_t size = kBlockSize + gen() % (kMaxRequest - kBlockSize + 1);
+    uint8_t* ptr = s.alloc.allocate(size, thread);
+    ptr[0] = static_cast<uint8_t>(thread);
+    out.push_back({ptr, size, static_cast<uint32_t>(thread)});
+  }
+  return kBatch;
+}
+
+// Returns number of deallocations
+std::size_t free_all(run_state& s, std::vector<block>& blocks) {
+  for (const block& b : blocks) {
+    s.alloc.deallocate(b.ptr, b.size, b.owner);
+  }
+  std::size_t res = blocks.size();
+  blocks.clear();
+  return res;
+}
+
+// Frees everything sent to thread, returns number of blocks freed
+std::size_t drain(run_state& s, std::size_t thread, std::vector<block>& scratch) {
+  mailbox& box = s.boxes[thread];
+  {
+    std::lock_guard<std::mutex> guard(box.lock);
+    scratch.swap(box.blocks);
+  }
+  return free_all(s, scratch);
+}
+
+// Returns number of blocks freed from own mailbox while waiting
+std::size_t send(run_state& s, std::size_t thread, std::size_t to, std::vector<block>& blocks,
+                 std::vector<block>& scratch) {
+  mailbox& box = s.boxes[to];
+  std::size_t res = 0;
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> guard(box.lock);
+      if (box.blocks.size() < kMailboxLimit) {
+        box.blocks.insert(box.blocks.end(), blocks.begin(), blocks.end());
+        blocks.clear();
+        return res;
+      }
+    }
+    // Keep own mailbox moving so that threads waiting on each other progress
+    std::size_t freed = drain(s, thread, scratch);
+    if (!freed) {
+      std::this_thread::yield();
+    }
+    res += freed;
+  }
+}
+
+// Patterns return number of allocations and deallocations made by thread
+
+std::size_t run_private(run_state& s, std::size_t thread) {
+  std::mt19937 gen(thread);
+  std::vector<block> blocks;
+  std::size_t res = 0;
+  for (std::size_t done = 0; done < s.ops; done += kBatch) {
+    res += allocate_batch(s, thread, gen, blocks);
+    std::shuffle(blocks.begin(), blocks.end(), gen);
+    res += free_all(s, blocks);
+  }
+  return res;
+}
+
+std::size_t run_producer_consumer(run_state& s, std::size_t thread) {
+  // Odd thread out works alone
+  if (thread + 1 == s.threads && thread % 2 == 0) {
+    return run_private(s, thread);
+  }
+  std::vector<block> blocks;
+  std::vector<block> scratch;
+  mailbox& box = s.boxes[thread | 1];
+  std::size_t res = 0;
+  if (thread % 2 == 0) {
+    std::mt19937 gen(thread);
+    for (std::size_t done = 0; done < s.ops; done += kBatch) {
+      res += allocate_batch(s, thread, gen, blocks);
+      res += send(s, thread, thread | 1, blocks, scratch);
+    }
+    box.closed.store(true, std::memory_order_release);
+  } else {
+    while (!box.closed.load(std::memory_order_acquire)) {
+      std::size_t freed = drain(s, thread, scratch);
+      if (!freed) {
+        std::this_thread::yield();
+      }
+      res += freed;
+    }
+    res += drain(s, thread, scratch);
+  }
+  return res;
+}
+
+std::size_t run_all_to_all(run_state& s, std::size_t thread) {
+  std::mt19937 gen(thread);
+  std::vector<block> blocks;
+  std::vector<block> scratch;
+  std::size_t round = 0;
+  std::size_t res = 0;
+  for (std::size_t done = 0; done < s.ops; done += kBatch, ++round) {
+    res += allocate_batch(s, thread, gen, blocks);
+    std::size_t to = (s.threads > 1) ? (thread + 1 + round % (s.threads - 1)) % s.threads : thread;
+    res += send(s, thread, to, blocks, scratch);
+    res += drain(s, thread, scratch);
+  }
+  s.producing.fetch_sub(1, std::memory_order_acq_rel);
+  while (s.producing.load(std::memory_order_acquire)) {
+    std::size_t freed = drain(s, thread, scratch);
+    if (!freed) {
+      std::this_thread::yield();
+    }
+    res += freed;
+  }
+  res += drain(s, thread, scratch);
+  return res;
+}
+
+using pattern_type = std::size_t (*)(run_state&, std::size_t);
+
+// Allocations and deallocations per second over all threads
+double run(pattern_type pattern, const std::string& name, std::size_t threads, std::size_t ops) {
+  std::unique_ptr<target> alloc = make_target(name, threads);
+  run_state s(*alloc, threads, ops);
+  std::atomic<std::size_t> total{0};
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&s, &total, pattern, i] {
+      while (!s.go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      total.fetch_add(pattern(s, i), std::memory_order_relaxed);
+    });
+  }
+  auto start = std::chrono::steady_clock::now();
+  s.go.store(true, std::memory_order_release);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return total.load(std::memory_order_relaxed) / elapsed.count();
+}
+
+int usage() {
+  std::fprintf(stderr, "usage: alloc_scaling [--threads n] [--ops n] [--out file]\n");
+  return 1;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::size_t max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  std::size_t ops = 200000;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 == argc) {
+      return usage();
+    } else if (arg == "--threads") {
+      max_threads = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--ops") {
+      ops = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+    } else if (arg == "--out") {
+      path = argv[++i];
+    } else {
+      return usage();
+    }
+  }
+  std::FILE* out = path ? std::fopen(path, "w") : stdout;
+  if (!out) {
+    std::fprintf(stderr, "alloc_scaling: cannot open %s\n", path);
+    return 1;
+  }
+
+  std::vector<std::size_t> thread_counts;
+  for (std::size_t n = 1; n < max_threads; n *= 2) {
+    thread_counts.push_back(n);
+  }
+  thread_counts.push_back(max_threads);
+
+  const std::pair<const char*, pattern_type> patterns[] = {
+      {"private", run_private},
+      {"producer_consumer", run_producer_consumer},
+      {"all_to_all", run_all_to_all},
+  };
+  const char* allocators[] = {"malloc", "pool_locked", "pool_per_thread", "concurrent_pool",
+                              "caching_pool"};
+
+  std::fprintf(out, "{\n  \"ops_per_thread\": %zu,\n  \"results\": [", ops);
+  const char* sep = "\n";
+  for (const auto& [pattern_name, pattern] : patterns) {
+    for (const char* name : allocators) {
+      double baseline = 0;
+      for (std::size_t threads : thread_counts) {
+        double rate = run(pattern, name, threads, ops);
+        double per_thread = rate / threads;
+        if (threads == 1) {
+          baseline = per_thread;
+        }
+        std::fprintf(out,
+                     "%s    {\"pattern\": \"%s\", \"allocator\": \"%s\", \"threads\": %zu, "
+                     "\"ops_per_sec\": %.0f, \"ops_per_sec_per_thread\": %.0f, "
+                     "\"efficiency\": %.3f}",
+                     sep, pattern_name, name, threads, rate, per_thread,
+                     baseline ? per_thread / baseline : 0.0);
+        sep = ",\n";
+      }
+    }
+  }
+  std::fprintf(out, "\n  ]\n}\n");
+  if (path) {
+    std::fclose(out);
+  }
+  return 0;
+}
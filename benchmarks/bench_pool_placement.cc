@@ -0,0 +1,94 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "memory/allocators/pool_allocator.h"
+
+namespace {
+constexpr std::size_t kPoolSize = 1 << 22;
+
+struct event {
+  std::size_t slot;
+  std::size_t size;
+  bool alloc;
+};
+
+// Mix of short lived small objects and long lived buffers keeping the pool
+// around target percent full
+std::vector<event> make_trace(std::size_t ops, std::size_t target, uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::vector<event> trace;
+  std::vector<std::size_t> live;
+  std::vector<std::size_t> sizes;
+  std::size_t live_bytes = 0;
+  trace.reserve(ops);
+  for (std::size_t i = 0; i < ops; ++i) {
+    bool alloc = live.empty() || (live_bytes < kPoolSize*target/100 && gen() % 3);
+    if (alloc) {
+      std::size_t size = (gen() % 8) ? 16 + gen() % 256 : 1024 + gen() % 16384;
+      std::size_t slot = sizes.size();
+      sizes.push_back(size);
+      live.push_back(slot);
+      live_bytes += size;
+      trace.push_back({slot, size, true});
+    } else {
+      // Small objects die young
+      std::size_t idx = (gen() % 4) ? live.size() - 1 - gen() % std::min<std::size_t>(live.size(), 16)
+                                    : gen() % live.size();
+      std::size_t slot = live[idx];
+      live[idx] = live.back();
+      live.pop_back();
+      live_bytes -= sizes[slot];
+      trace.push_back({slot, sizes[slot], false});
+    }
+  }
+  for (std::size_t slot : live) {
+    trace.push_back({slot, sizes[slot], false});
+  }
+  return trace;
+}
+
+template <typename Placement>
+void BM_placement(benchmark::State& state) {
+  const std::vector<event> trace = make_trace(200000, state.range(0), 42);
+  std::size_t slots = 0;
+  for (const event& e : trace) slots = std::max(slots, e.slot + 1);
+  std::vector<uint8_t*> ptrs(slots);
+  std::size_t failed = 0;
+  double fragmentation = 0;
+  std::size_t samples = 0;
+
+  memory::pool_allocator<uint8_t, Placement> al(kPoolSize, 16);
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < trace.size(); ++i) {
+      const event& e = trace[i];
+      if (e.alloc) {
+        try {
+          ptrs[e.slot] = al.allocate(e.size);
+        } catch (std::bad_alloc&) {
+          ptrs[e.slot] = nullptr;
+          ++failed;
+        }
+      } else if (ptrs[e.slot]) {
+        al.deallocate(ptrs[e.slot], e.size);
+      }
+      if (i % 4096 == 0 && al.remaining()) {
+        state.PauseTiming();
+        fragmentation += 1.0 - double(al.largest_free()) / al.remaining();
+        ++samples;
+        state.ResumeTiming();
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*trace.size());
+  state.counters["failed"] = benchmark::Counter(failed, benchmark::Counter::kAvgIterations);
+  state.counters["fragmentation"] = samples ? fragmentation / samples : 0;
+}
+}  // namespace
+
+BENCHMARK_TEMPLATE(BM_placement, memory::first_fit)->Arg(50)->Arg(90);
+BENCHMARK_TEMPLATE(BM_placement, memory::next_fit)->Arg(50)->Arg(90);
+BENCHMARK_TEMPLATE(BM_placement, memory::best_fit)->Arg(50)->Arg(90);
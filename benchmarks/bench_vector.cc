@@ -0,0 +1,140 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "memory/containers/vector.h"
+#include "../tests/test_helpers.h"
+
+namespace {
+// Element of every type constructible from an index; strings are too long
+// for the small string buffer
+template <typename T>
+T make(std::size_t i) {
+  if constexpr (std::is_arithmetic_v<T>) {
+    return static_cast<T>(i);
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return std::string(32, static_cast<char>('a' + i % 26));
+  } else {
+    return T(std::to_string(i));
+  }
+}
+
+template <typename Vector>
+Vector filled(std::size_t count) {
+  Vector res;
+  res.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    res.push_back(make<typename Vector::value_type>(i));
+  }
+  return res;
+}
+
+template <typename Vector>
+void BM_push_back(benchmark::State& state) {
+  using T = typename Vector::value_type;
+  const T value = make<T>(1);
+  for (auto _ : state) {
+    Vector vec;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      vec.push_back(value);
+    }
+    benchmark::DoNotOptimize(vec.data());
+  }
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+template <typename Vector>
+void BM_emplace_back(benchmark::State& state) {
+  using T = typename Vector::value_type;
+  for (auto _ : state) {
+    Vector vec;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+      if constexpr (std::is_arithmetic_v<T>) {
+        vec.emplace_back(static_cast<T>(i));
+      } else {
+        vec.emplace_back("emplaced element, long enough");
+      }
+    }
+    benchmark::DoNotOptimize(vec.data());
+  }
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+// Inserts and erases one element at range(1) percent of a vector of range(0)
+// elements, so the size stays the same
+template <typename Vector>
+void BM_insert_erase(benchmark::State& state) {
+  using T = typename Vector::value_type;
+  Vector vec = filled<Vector>(state.range(0));
+  const T value = make<T>(7);
+  std::size_t pos = vec.size()*state.range(1)/100;
+  for (auto _ : state) {
+    vec.insert(vec.begin() + pos, value);
+    vec.erase(vec.begin() + pos);
+    benchmark::DoNotOptimize(vec.data());
+  }
+  state.SetItemsProcessed(state.iterations()*2);
+}
+
+template <typename Vector>
+void BM_copy(benchmark::State& state) {
+  const Vector vec = filled<Vector>(state.range(0));
+  for (auto _ : state) {
+    Vector copy(vec);
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+template <typename Vector>
+void BM_move(benchmark::State& state) {
+  Vector vec = filled<Vector>(state.range(0));
+  for (auto _ : state) {
+    Vector moved(std::move(vec));
+    benchmark::DoNotOptimize(moved.data());
+    vec.swap(moved);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Vector>
+void BM_resize(benchmark::State& state) {
+  for (auto _ : state) {
+    Vector vec;
+    vec.resize(state.range(0));
+    benchmark::DoNotOptimize(vec.data());
+  }
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+
+template <typename Vector>
+void BM_iterate(benchmark::State& state) {
+  Vector vec = filled<Vector>(state.range(0));
+  for (auto _ : state) {
+    for (auto& value : vec) {
+      benchmark::DoNotOptimize(value);
+    }
+  }
+  state.SetItemsProcessed(state.iterations()*state.range(0));
+}
+}  // namespace
+
+// Same benchmark for both vectors over every element type
+#define BENCHMARK_VECTORS(func, ...)                                 \
+  BENCHMARK_TEMPLATE(func, std::vector<int>) __VA_ARGS__;           \
+  BENCHMARK_TEMPLATE(func, memory::vector<int>) __VA_ARGS__;        \
+  BENCHMARK_TEMPLATE(func, std::vector<std::string>) __VA_ARGS__;   \
+  BENCHMARK_TEMPLATE(func, memory::vector<std::string>) __VA_ARGS__;\
+  BENCHMARK_TEMPLATE(func, std::vector<large>) __VA_ARGS__;         \
+  BENCHMARK_TEMPLATE(func, memory::vector<large>) __VA_ARGS__
+
+BENCHMARK_VECTORS(BM_push_back, ->Arg(16)->Arg(4096));
+BENCHMARK_VECTORS(BM_emplace_back, ->Arg(16)->Arg(4096));
+BENCHMARK_VECTORS(BM_insert_erase, ->Args({1024, 0})->Args({1024, 50})->Args({1024, 100}));
+BENCHMARK_VECTORS(BM_copy, ->Arg(16)->Arg(4096));
+BENCHMARK_VECTORS(BM_move, ->Arg(4096));
+BENCHMARK_VECTORS(BM_resize, ->Arg(16)->Arg(4096));
+BENCHMARK_VECTORS(BM_iterate, ->Arg(4096));
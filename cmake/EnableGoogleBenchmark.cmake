@@ -0,0 +1,19 @@
+if (POLICY CMP0135)
+  cmake_policy(SET CMP0135 NEW)
+endif()
+
+find_package(benchmark CONFIG)
+
+if(NOT benchmark_FOUND AND FETCH_BENCHMARK)
+  include(FetchContent)
+  FetchContent_Declare(
+    googlebenchmark
+    URL https://github.com/google/benchmark/archive/refs/tags/v1.8.3.zip
+    EXCLUDE_FROM_ALL
+  )
+
+  set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+  set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+  FetchContent_MakeAvailable(googlebenchmark)
+  set(benchmark_FOUND TRUE)
+endif()
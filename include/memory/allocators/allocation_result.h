@@ -0,0 +1,16 @@
+#ifndef MEMORY_ALLOCATORS_ALLOCATION_RESULT_H_
+#define MEMORY_ALLOCATORS_ALLOCATION_RESULT_H_
+#include <cstddef>
+
+namespace memory {
+// Result of allocate_at_least(n), same as std::allocation_result of C++23.
+// count is at least n and the block may be deallocated with any count
+// between n and count.
+template <typename Pointer, typename SizeType = std::size_t>
+struct allocation_result {
+  Pointer ptr;
+  SizeType count;
+};
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_ALLOCATION_RESULT_H_
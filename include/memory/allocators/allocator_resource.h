@@ -0,0 +1,103 @@
+#ifndef MEMORY_ALLOCATORS_ALLOCATOR_RESOURCE_H_
+#define MEMORY_ALLOCATORS_ALLOCATOR_RESOURCE_H_
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace memory {
+// std::pmr::memory_resource over any allocator of this library (or any other
+// allocator satisfying Allocator requirements). Resource holds a copy of the
+// allocator rebound to std::byte, so std::pmr containers share the state with
+// every other copy: one pool backs both memory and std::pmr containers.
+//
+// Allocators providing allocate(count, alignment) get the alignment passed
+// through, as do those providing deallocate(ptr, count, alignment). Others
+// can serve alignments up to alignof(std::max_align_t), stronger ones throw
+// std::bad_alloc. Allocators providing allocate_bytes(bytes, alignment) and
+// deallocate_bytes(ptr, bytes, alignment) get every request as one object.
+//
+// memory_resource destructor cannot throw, so the leak check of the wrapped
+// allocator terminates the program if the resource holds its last copy.
+template <typename Allocator>
+class allocator_resource : public std::pmr::memory_resource {
+ public:
+  using allocator_type =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<std::byte>;
+
+  explicit allocator_resource(const Allocator& alloc) : alloc_(alloc) {}
+
+  allocator_resource(const allocator_resource&) = delete;
+  allocator_resource& operator=(const allocator_resource&) = delete;
+
+  ~allocator_resource() noexcept override {}
+
+  allocator_type get_allocator() const {
+    return alloc_;
+  }
+
+ protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    if constexpr (has_bytes<allocator_type>::value) {
+      return alloc_.allocate_bytes(bytes, alignment);
+    } else if constexpr (has_aligned_allocate<allocator_type>::value) {
+      return alloc_.allocate(bytes, alignment);
+    } else {
+      if (alignment > alignof(std::max_align_t)) {
+        throw std::bad_alloc();
+      }
+      return std::allocator_traits<allocator_type>::allocate(alloc_, bytes);
+    }
+  }
+
+  void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+    std::byte* p = static_cast<std::byte*>(ptr);
+    if constexpr (has_bytes<allocator_type>::value) {
+      alloc_.deallocate_bytes(ptr, bytes, alignment);
+    } else if constexpr (has_aligned_deallocate<allocator_type>::value) {
+      alloc_.deallocate(p, bytes, alignment);
+    } else {
+      std::allocator_traits<allocator_type>::deallocate(alloc_, p, bytes);
+    }
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    if (this == &other) {
+      return true;
+    }
+    auto* res = dynamic_cast<const allocator_resource*>(&other);
+    return res && res->alloc_ == alloc_;
+  }
+
+ private:
+  template <typename A, typename = void>
+  struct has_aligned_allocate : std::false_type {};
+
+  template <typename A>
+  struct has_aligned_allocate<A, std::void_t<decltype(
+      std::declval<A&>().allocate(std::size_t(), std::size_t()))>> : std::true_type {};
+
+  template <typename A, typename = void>
+  struct has_aligned_deallocate : std::false_type {};
+
+  template <typename A>
+  struct has_aligned_deallocate<A, std::void_t<decltype(
+      std::declval<A&>().deallocate(std::declval<std::byte*>(), std::size_t(), std::size_t()))>>
+      : std::true_type {};
+
+  template <typename A, typename = void>
+  struct has_bytes : std::false_type {};
+
+  template <typename A>
+  struct has_bytes<A, std::void_t<
+      decltype(std::declval<A&>().allocate_bytes(std::size_t(), std::size_t())),
+      decltype(std::declval<A&>().deallocate_bytes(
+          std::declval<void*>(), std::size_t(), std::size_t()))>> : std::true_type {};
+
+  allocator_type alloc_;
+};
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_ALLOCATOR_RESOURCE_H_
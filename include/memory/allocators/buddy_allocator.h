@@ -0,0 +1,297 @@
+#ifndef MEMORY_ALLOCATORS_BUDDY_ALLOCATOR_H_
+#define MEMORY_ALLOCATORS_BUDDY_ALLOCATOR_H_
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "allocation_result.h"
+
+namespace memory {
+// No general requirements on type T
+//
+// Binary buddy allocator. Pool is split into blocks of min_block << order
+// bytes, every allocation takes the smallest block that fits it, splitting
+// larger ones on the way down, and freed blocks merge with their free buddy
+// on the way up. Both are O(log(size / min_block)). Free blocks of every order
+// are kept in intrusive doubly linked lists, so the pool memory is not
+// touched until it is handed out or freed.
+//
+// Pool size does not have to be a power of two, it is covered with the
+// largest blocks that fit. allocd() and remaining() count whole blocks.
+// Blocks are aligned to their size up to kMaxAlignment.
+template <typename T>
+class buddy_allocator {
+  template <typename U>
+  friend class buddy_allocator;
+
+  struct node {
+    node* prev;
+    node* next;
+  };
+
+  struct trace_type {
+    std::size_t allocd;
+    std::size_t limit;
+    std::size_t ref_count;
+    std::size_t min_shift;
+    std::size_t alignment;
+    node* heads[64];
+  };
+
+  // Tag of the first min_block of every block head, zero elsewhere
+  static constexpr uint8_t kFree = 0x80;
+  static constexpr uint8_t kUsed = 0x40;
+  static constexpr uint8_t kOrder = 0x3f;
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::true_type;
+
+  static constexpr size_type kPoolAlignment = 64;
+  static constexpr size_type kMaxAlignment = 4096;
+
+  // min_block must be a power of two not less than two pointers, size is
+  // rounded up to whole min_blocks
+  explicit buddy_allocator(size_type size, size_type min_block = 16)
+      : trace_(alloc_trace(size, min_block)) {
+    size_type blocks = (size + min_block - 1) / min_block;
+    trace_->allocd = 0;
+    trace_->limit = blocks*min_block;
+    trace_->ref_count = 1;
+    trace_->min_shift = log2(min_block);
+    trace_->alignment = pool_alignment(blocks, min_block);
+    pool_ = reinterpret_cast<uint8_t*>(trace_) + pool_offset(blocks, min_block);
+    // Largest blocks first, so each one is aligned to its size
+    size_type offs = 0;
+    for (size_type order = log2(blocks) + 1; order--;) {
+      if (blocks & (size_type(1) << order)) {
+        push(offs, order);
+        offs += block(order);
+      }
+    }
+  }
+
+  template <typename U>
+  buddy_allocator(const buddy_allocator<U>& other) noexcept
+      : pool_(other.pool_), trace_(reinterpret_cast<trace_type*>(other.trace_)) {
+    ++trace_->ref_count;
+  }
+
+  template <typename U>
+  buddy_allocator(buddy_allocator<U>&& other) noexcept : buddy_allocator(other) {}
+
+  buddy_allocator(const buddy_allocator& other) noexcept
+      : pool_(other.pool_), trace_(other.trace_) {
+    ++trace_->ref_count;
+  }
+
+  buddy_allocator(buddy_allocator&& other) noexcept : buddy_allocator(other) {}
+
+  template <typename U>
+  buddy_allocator& operator=(const buddy_allocator<U>& other) = delete;
+
+  template <typename U>
+  buddy_allocator& operator=(buddy_allocator<U>&&) = delete;
+
+  buddy_allocator& operator=(const buddy_allocator& other) = delete;
+
+  buddy_allocator& operator=(buddy_allocator&&) = delete;
+
+  virtual ~buddy_allocator() noexcept(false) {
+    if (!--trace_->ref_count) {
+      bool leaked = trace_->allocd;
+      free_trace();
+      if (leaked) {
+        throw std::runtime_error("Memory leak detected: attempting to destroy buddy allocator that has memory being used and not dealloc'd'");
+      }
+    }
+  }
+
+  //==============================================================================
+
+  size_type max_size() const noexcept {
+    return trace_->limit / sizeof(T);
+  }
+
+  size_type allocd() const noexcept {
+    return trace_->allocd;
+  }
+
+  size_type remaining() const noexcept {
+    return trace_->limit - trace_->allocd;
+  }
+
+  size_type min_block() const noexcept {
+    return size_type(1) << trace_->min_shift;
+  }
+  //==============================================================================
+
+  void swap(buddy_allocator& other) noexcept {
+    std::swap(trace_, other.trace_);
+    std::swap(pool_, other.pool_);
+  }
+
+  T* allocate(size_type count) {
+    return allocate(count, alignof(T));
+  }
+
+  // alignment must be a power of two
+  T* allocate(size_type count, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    if (alignment > trace_->alignment || count > max_size()) {
+      throw std::bad_alloc();
+    }
+    size_type order = order_of(std::max(count*sizeof(T), alignment));
+    size_type from = order;
+    for (; from < 64 && !trace_->heads[from]; ++from) {}
+    if (from == 64) {
+      throw std::bad_alloc();
+    }
+    size_type offs = pop(from);
+    while (from > order) {
+      --from;
+      push(offs + block(from), from);
+    }
+    tag(offs) = kUsed | order;
+    trace_->allocd += block(order);
+    return reinterpret_cast<T*>(pool_ + offs);
+  }
+
+  // Same as allocate(count), count of the result fills the whole buddy block
+  allocation_result<T*> allocate_at_least(size_type count) {
+    T* ptr = allocate(count);
+    size_type bytes = block(order_of(std::max(count*sizeof(T), alignof(T))));
+    return {ptr, std::max(count, bytes / sizeof(T))};
+  }
+
+  void deallocate(T* ptr, size_type) noexcept {
+    size_type offs = reinterpret_cast<uint8_t*>(ptr) - pool_;
+    if (offs >= trace_->limit || (offs & (min_block() - 1)) || !(tag(offs) & kUsed)) {
+      return;
+    }
+    size_type order = tag(offs) & kOrder;
+    tag(offs) = 0;
+    trace_->allocd -= block(order);
+    for (;; ++order) {
+      size_type buddy = offs ^ block(order);
+      if (buddy + block(order) > trace_->limit || tag(buddy) != (kFree | order)) {
+        break;
+      }
+      unlink(buddy, order);
+      offs &= ~block(order);
+    }
+    push(offs, order);
+  }
+
+  bool operator==(const buddy_allocator& other) const noexcept {
+    return trace_ == other.trace_;
+  }
+
+  bool operator!=(const buddy_allocator& other) const noexcept {
+    return trace_ != other.trace_;
+  }
+
+ private:
+  static constexpr size_type log2(size_type value) noexcept {
+    size_type res = 0;
+    for (; value >>= 1; ++res) {}
+    return res;
+  }
+
+  // Block size of given order in bytes
+  size_type block(size_type order) const noexcept {
+    return size_type(1) << (order + trace_->min_shift);
+  }
+
+  // Smallest order holding bytes
+  size_type order_of(size_type bytes) const noexcept {
+    size_type blocks = (bytes + min_block() - 1) >> trace_->min_shift;
+    return (blocks > 1) ? log2(blocks - 1) + 1 : 0;
+  }
+
+  uint8_t& tag(size_type offs) const noexcept {
+    return reinterpret_cast<uint8_t*>(trace_ + 1)[offs >> trace_->min_shift];
+  }
+
+  void push(size_type offs, size_type order) noexcept {
+    node* n = reinterpret_cast<node*>(pool_ + offs);
+    n->prev = nullptr;
+    n->next = trace_->heads[order];
+    if (n->next) {
+      n->next->prev = n;
+    }
+    trace_->heads[order] = n;
+    tag(offs) = kFree | order;
+  }
+
+  size_type pop(size_type order) noexcept {
+    node* n = trace_->heads[order];
+    size_type offs = reinterpret_cast<uint8_t*>(n) - pool_;
+    unlink(offs, order);
+    return offs;
+  }
+
+  void unlink(size_type offs, size_type order) noexcept {
+    node* n = reinterpret_cast<node*>(pool_ + offs);
+    if (n->prev) {
+      n->prev->next = n->next;
+    } else {
+      trace_->heads[order] = n->next;
+    }
+    if (n->next) {
+      n->next->prev = n->prev;
+    }
+    tag(offs) = 0;
+  }
+
+  // Largest block is aligned to its size, capped by kMaxAlignment
+  static constexpr size_type pool_alignment(size_type blocks, size_type min_block) noexcept {
+    size_type align = min_block << log2(blocks);
+    return (align < kPoolAlignment) ? kPoolAlignment
+         : (align > kMaxAlignment) ? kMaxAlignment : align;
+  }
+
+  // Offset of the pool from the start of the trace, tags lie in between
+  static constexpr size_type pool_offset(size_type blocks, size_type min_block) noexcept {
+    size_type align = pool_alignment(blocks, min_block);
+    return (sizeof(trace_type) + blocks + align - 1) / align * align;
+  }
+
+  trace_type* alloc_trace(size_type size, size_type min_block) {
+    if (!size) throw std::bad_alloc();
+    if ((min_block & (min_block - 1)) || min_block < sizeof(node)) {
+      throw std::invalid_argument("Buddy block size must be a power of two and hold two pointers");
+    }
+    size_type blocks = (size + min_block - 1) / min_block;
+    size_type offs = pool_offset(blocks, min_block);
+    trace_type* ptr = reinterpret_cast<trace_type*>(
+        operator new(offs + blocks*min_block, std::align_val_t(pool_alignment(blocks, min_block))));
+    std::memset(ptr, 0, offs);
+    return ptr;
+  }
+
+  void free_trace() noexcept {
+    operator delete(trace_, std::align_val_t(trace_->alignment));
+  }
+
+  uint8_t* pool_;
+  trace_type* trace_;
+};
+
+template <typename T>
+void swap(buddy_allocator<T>& lhs, buddy_allocator<T>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_BUDDY_ALLOCATOR_H_
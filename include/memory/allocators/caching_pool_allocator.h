@@ -0,0 +1,377 @@
+#ifndef MEMORY_ALLOCATORS_CACHING_POOL_ALLOCATOR_H_
+#define MEMORY_ALLOCATORS_CACHING_POOL_ALLOCATOR_H_
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "concurrent_pool_allocator.h"
+
+namespace memory {
+// Shared part of caching_pool_allocator, not meant to be used directly.
+//
+// Small requests (up to kMaxCached bytes with alignment not stronger than
+// kGranularity) are served from per-thread free lists, one list per size class.
+// Lists are refilled from the shared pool with one contiguous allocation per
+// batch and drained back a batch at a time once they grow too long, each run
+// of adjacent objects in the batch with one deallocation, so the common path
+// touches only memory owned by the calling thread.
+//
+// Thread caches are flushed back to the pool when their thread exits, when
+// flush() is called or when the pool itself is destroyed, whichever comes first.
+class pool_cache_state {
+ public:
+  using size_type = std::size_t;
+
+  static constexpr size_type kGranularity = 16;
+  static constexpr size_type kClasses = 16;
+  static constexpr size_type kMaxCached = kGranularity*kClasses;
+  static constexpr size_type kBatchBytes = 4096;
+
+  explicit pool_cache_state(size_type size)
+      : ref_count(1), pool_(size, kGranularity), link_(std::make_shared<link>(this)),
+        id_(next_id()) {}
+
+  pool_cache_state(const pool_cache_state&) = delete;
+  pool_cache_state& operator=(const pool_cache_state&) = delete;
+
+  // Takes every thread cache back, remaining allocations are reported as a
+  // leak by the pool
+  ~pool_cache_state() noexcept(false) {
+    std::lock_guard<std::mutex> lock(link_->mutex);
+    for (thread_cache* cache : caches_) {
+      drain(*cache);
+    }
+    caches_.clear();
+    link_->state = nullptr;
+  }
+
+  void* allocate(size_type bytes, size_type alignment) {
+    if (!cached(bytes, alignment)) {
+      return pool_.allocate(bytes, alignment);
+    }
+    thread_cache& cache = local();
+    size_type cls = (bytes - 1) / kGranularity;
+    if (!cache.heads[cls]) {
+      refill(cache, cls);
+    }
+    node* res = cache.heads[cls];
+    cache.heads[cls] = res->next;
+    --cache.counts[cls];
+    return res;
+  }
+
+  void deallocate(void* ptr, size_type bytes, size_type alignment) noexcept {
+    if (!cached(bytes, alignment)) {
+      pool_.deallocate(static_cast<uint8_t*>(ptr), bytes);
+      return;
+    }
+    thread_cache* cache = local_nothrow();
+    size_type cls = (bytes - 1) / kGranularity;
+    if (!cache) {
+      pool_.deallocate(static_cast<uint8_t*>(ptr), class_size(cls));
+      return;
+    }
+    node* n = static_cast<node*>(ptr);
+    n->next = cache->heads[cls];
+    cache->heads[cls] = n;
+    if (++cache->counts[cls] > 2*batch(cls)) {
+      release(*cache, cls, batch(cls));
+    }
+  }
+
+  // Returns everything cached by the calling thread to the pool
+  void flush() noexcept {
+    thread_cache* cache = local_nothrow();
+    if (cache) {
+      drain(*cache);
+    }
+  }
+
+  size_type max_size() const noexcept { return pool_.max_size(); }
+  size_type allocd() const noexcept { return pool_.allocd(); }
+  size_type remaining() const noexcept { return pool_.remaining(); }
+
+  std::atomic<size_type> ref_count;
+
+ private:
+  struct node {
+    node* next;
+  };
+
+  struct link;
+
+  struct thread_cache {
+    explicit thread_cache(const std::shared_ptr<link>& owner, uint64_t owner_id) noexcept
+        : heads(), counts(), pool(owner), id(owner_id) {}
+
+    // Flushes itself if the pool is still alive
+    ~thread_cache() {
+      std::lock_guard<std::mutex> lock(pool->mutex);
+      if (pool->state) {
+        pool->state->detach(*this);
+      }
+    }
+
+    node* heads[kClasses];
+    size_type counts[kClasses];
+    std::shared_ptr<link> pool;
+    uint64_t id;
+  };
+
+  // Outlives the state, lets exiting threads find out whether it is gone
+  struct link {
+    explicit link(pool_cache_state* owner) noexcept : state(owner) {}
+
+    std::mutex mutex;
+    pool_cache_state* state;
+  };
+
+  // Caches of the calling thread, one per pool it has used
+  struct registry {
+    std::vector<std::unique_ptr<thread_cache>> caches;
+    thread_cache* last = nullptr;
+  };
+
+  static registry& local_registry() noexcept {
+    thread_local registry instance;
+    return instance;
+  }
+
+  static uint64_t next_id() noexcept {
+    static std::atomic<uint64_t> ids{0};
+    return ids.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static constexpr bool cached(size_type bytes, size_type alignment) noexcept {
+    return bytes && bytes <= kMaxCached && alignment <= kGranularity;
+  }
+
+  static constexpr size_type class_size(size_type cls) noexcept {
+    return (cls + 1)*kGranularity;
+  }
+
+  static constexpr size_type batch(size_type cls) noexcept {
+    return kBatchBytes / class_size(cls);
+  }
+
+  thread_cache* local_nothrow() noexcept {
+    registry& reg = local_registry();
+    if (reg.last && reg.last->id == id_) {
+      return reg.last;
+    }
+    for (auto& cache : reg.caches) {
+      if (cache->id == id_) {
+        return reg.last = cache.get();
+      }
+    }
+    return nullptr;
+  }
+
+  thread_cache& local() {
+    thread_cache* res = local_nothrow();
+    if (res) {
+      return *res;
+    }
+    registry& reg = local_registry();
+    // Drop caches of pools that are already gone
+    reg.caches.erase(std::remove_if(reg.caches.begin(), reg.caches.end(),
+        [](const std::unique_ptr<thread_cache>& cache) {
+          std::lock_guard<std::mutex> lock(cache->pool->mutex);
+          return !cache->pool->state;
+        }), reg.caches.end());
+    reg.caches.push_back(std::make_unique<thread_cache>(link_, id_));
+    res = reg.caches.back().get();
+    {
+      std::lock_guard<std::mutex> lock(link_->mutex);
+      caches_.push_back(res);
+    }
+    return *(reg.last = res);
+  }
+
+  // Takes a batch of objects from the pool as one run, falls back to a single
+  // object if the pool is too fragmented for a whole batch
+  void refill(thread_cache& cache, size_type cls) {
+    size_type size = class_size(cls);
+    size_type count = batch(cls);
+    uint8_t* chunk;
+    try {
+      chunk = pool_.allocate(count*size, kGranularity);
+    } catch (std::bad_alloc&) {
+      chunk = pool_.allocate(size, kGranularity);
+      count = 1;
+    }
+    for (size_type i = count; i; --i) {
+      node* n = reinterpret_cast<node*>(chunk + (i - 1)*size);
+      n->next = cache.heads[cls];
+      cache.heads[cls] = n;
+    }
+    cache.counts[cls] += count;
+  }
+
+  // Returns count objects of class cls to the pool. Objects are sorted by
+  // address in batches and every run of adjacent ones is freed at once.
+  void release(thread_cache& cache, size_type cls, size_type count) noexcept {
+    size_type size = class_size(cls);
+    uint8_t* objects[kBatchBytes / kGranularity];
+    while (count && cache.heads[cls]) {
+      size_type n = 0;
+      for (; n < batch(cls) && count && cache.heads[cls]; ++n, --count) {
+        node* head = cache.heads[cls];
+        cache.heads[cls] = head->next;
+        --cache.counts[cls];
+        objects[n] = reinterpret_cast<uint8_t*>(head);
+      }
+      std::sort(objects, objects + n);
+      for (size_type i = 0; i < n;) {
+        size_type j = i + 1;
+        for (; j < n && objects[j] == objects[i] + (j - i)*size; ++j) {}
+        pool_.deallocate(objects[i], (j - i)*size);
+        i = j;
+      }
+    }
+  }
+
+  void drain(thread_cache& cache) noexcept {
+    for (size_type cls = 0; cls < kClasses; ++cls) {
+      release(cache, cls, cache.counts[cls]);
+    }
+  }
+
+  // Called with link mutex held by an exiting thread
+  void detach(thread_cache& cache) noexcept {
+    drain(cache);
+    caches_.erase(std::find(caches_.begin(), caches_.end(), &cache));
+  }
+
+  concurrent_pool_allocator<uint8_t> pool_;
+  std::shared_ptr<link> link_;
+  std::vector<thread_cache*> caches_;
+  uint64_t id_;
+};
+
+// No general requirements on type T
+//
+// Thread safe pool allocator with per-thread caches of small objects in front
+// of a concurrent_pool_allocator. Copies share the pool and the caches.
+// allocd() and remaining() account for objects held in thread caches as
+// allocated.
+template <typename T>
+class caching_pool_allocator {
+  template <typename U>
+  friend class caching_pool_allocator;
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::true_type;
+
+  explicit caching_pool_allocator(size_type size)
+      : state_(new pool_cache_state(size)) {}
+
+  template <typename U>
+  caching_pool_allocator(const caching_pool_allocator<U>& other) noexcept
+      : state_(other.state_) {
+    state_->ref_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  template <typename U>
+  caching_pool_allocator(caching_pool_allocator<U>&& other) noexcept
+      : caching_pool_allocator(other) {}
+
+  caching_pool_allocator(const caching_pool_allocator& other) noexcept
+      : state_(other.state_) {
+    state_->ref_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  caching_pool_allocator(caching_pool_allocator&& other) noexcept
+      : caching_pool_allocator(other) {}
+
+  template <typename U>
+  caching_pool_allocator& operator=(const caching_pool_allocator<U>& other) = delete;
+
+  template <typename U>
+  caching_pool_allocator& operator=(caching_pool_allocator<U>&&) = delete;
+
+  caching_pool_allocator& operator=(const caching_pool_allocator& other) = delete;
+
+  caching_pool_allocator& operator=(caching_pool_allocator&&) = delete;
+
+  virtual ~caching_pool_allocator() noexcept(false) {
+    if (state_->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete state_;
+    }
+  }
+
+  //==============================================================================
+
+  size_type max_size() const noexcept {
+    return state_->max_size() / sizeof(T);
+  }
+
+  size_type allocd() const noexcept {
+    return state_->allocd();
+  }
+
+  size_type remaining() const noexcept {
+    return state_->remaining();
+  }
+
+  // Returns objects cached by the calling thread to the shared pool
+  void flush() noexcept {
+    state_->flush();
+  }
+  //==============================================================================
+
+  void swap(caching_pool_allocator& other) noexcept {
+    std::swap(state_, other.state_);
+  }
+
+  T* allocate(size_type count) {
+    return allocate(count, alignof(T));
+  }
+
+  // alignment must be a power of two, the same alignment must be passed to
+  // deallocate
+  T* allocate(size_type count, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    return static_cast<T*>(state_->allocate(count*sizeof(T), alignment));
+  }
+
+  void deallocate(T* ptr, size_type count) noexcept {
+    deallocate(ptr, count, alignof(T));
+  }
+
+  void deallocate(T* ptr, size_type count, size_type alignment) noexcept {
+    state_->deallocate(ptr, count*sizeof(T), alignment);
+  }
+
+  bool operator==(const caching_pool_allocator& other) const noexcept {
+    return state_ == other.state_;
+  }
+
+  bool operator!=(const caching_pool_allocator& other) const noexcept {
+    return state_ != other.state_;
+  }
+
+ private:
+  pool_cache_state* state_;
+};
+
+template <typename T>
+void swap(caching_pool_allocator<T>& lhs, caching_pool_allocator<T>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_CACHING_POOL_ALLOCATOR_H_
@@ -0,0 +1,334 @@
+#ifndef MEMORY_ALLOCATORS_CONCURRENT_POOL_ALLOCATOR_H_
+#define MEMORY_ALLOCATORS_CONCURRENT_POOL_ALLOCATOR_H_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <stdexcept>
+
+#include "pool_bitmap.h"
+
+namespace memory {
+// No general requirements on type T
+//
+// Thread safe counterpart of pool_allocator. Copies may be used from any
+// number of threads at once without external locking: bitmap words are
+// claimed with atomic read-modify-write operations, counters and reference
+// count are atomic.
+//
+// Allocation scans the bitmap with relaxed loads and then claims the found
+// run word by word. If another thread took any of the bits first, claimed
+// words are rolled back and the search goes on past the conflict. Every thread
+// starts its search from its own offset, so threads mostly work in different
+// parts of the pool and rarely contend for the same words.
+template <typename T>
+class concurrent_pool_allocator {
+  template <typename U>
+  friend class concurrent_pool_allocator;
+
+  using word_type = pool_bitmap::word_type;
+
+  struct trace_type {
+    std::atomic<std::size_t> allocd;
+    std::size_t limit;
+    std::atomic<std::size_t> ref_count;
+    std::size_t block_shift;
+  };
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::true_type;
+
+  static constexpr size_type kPoolAlignment = 64;
+
+  // block_size must be a power of two, size is rounded up to whole blocks
+  explicit concurrent_pool_allocator(size_type size, size_type block_size = 1)
+      : trace_(alloc_trace(size, block_size)) {
+    size_type blocks = (size + block_size - 1) / block_size;
+    pool_ = reinterpret_cast<uint8_t*>(trace_) + pool_offset(blocks, block_size);
+    new (trace_) trace_type{{0}, blocks*block_size, {1}, 0};
+    for (; (size_type(1) << trace_->block_shift) < block_size; ++trace_->block_shift) {}
+    size_type words = pool_bitmap::word_count(blocks);
+    for (size_type i = 0; i < words; ++i) {
+      new (state() + i) std::atomic<word_type>(0);
+    }
+    if (blocks % pool_bitmap::kWordBits) {
+      state()[words - 1].store(~pool_bitmap::mask(0, blocks % pool_bitmap::kWordBits),
+                               std::memory_order_relaxed);
+    }
+  }
+
+  template <typename U>
+  concurrent_pool_allocator(const concurrent_pool_allocator<U>& other) noexcept
+      : pool_(other.pool_), trace_(reinterpret_cast<trace_type*>(other.trace_)) {
+    trace_->ref_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  template <typename U>
+  concurrent_pool_allocator(concurrent_pool_allocator<U>&& other) noexcept
+      : concurrent_pool_allocator(other) {}
+
+  concurrent_pool_allocator(const concurrent_pool_allocator& other) noexcept
+      : pool_(other.pool_), trace_(other.trace_) {
+    trace_->ref_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  concurrent_pool_allocator(concurrent_pool_allocator&& other) noexcept
+      : concurrent_pool_allocator(other) {}
+
+  template <typename U>
+  concurrent_pool_allocator& operator=(const concurrent_pool_allocator<U>& other) = delete;
+
+  template <typename U>
+  concurrent_pool_allocator& operator=(concurrent_pool_allocator<U>&&) = delete;
+
+  concurrent_pool_allocator& operator=(const concurrent_pool_allocator& other) = delete;
+
+  concurrent_pool_allocator& operator=(concurrent_pool_allocator&&) = delete;
+
+  virtual ~concurrent_pool_allocator() noexcept(false) {
+    if (trace_->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (trace_->allocd.load(std::memory_order_relaxed)) {
+        free_trace();
+        throw std::runtime_error("Memory leak detected: attempting to destroy pool allocator that has memory being used and not dealloc'd'");
+      }
+      free_trace();
+    }
+  }
+
+  //==============================================================================
+
+  size_type max_size() const noexcept {
+    return trace_->limit / sizeof(T);
+  }
+
+  size_type allocd() const noexcept {
+    return trace_->allocd.load(std::memory_order_relaxed);
+  }
+
+  size_type remaining() const noexcept {
+    return trace_->limit - allocd();
+  }
+
+  size_type block_size() const noexcept {
+    return size_type(1) << trace_->block_shift;
+  }
+  //==============================================================================
+
+  void swap(concurrent_pool_allocator& other) noexcept {
+    if (trace_ != other.trace_) {
+      std::swap(trace_, other.trace_);
+      std::swap(pool_, other.pool_);
+    }
+  }
+
+  T* allocate(size_type count) {
+    return allocate(count, alignof(T));
+  }
+
+  // alignment must be a power of two
+  T* allocate(size_type count, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    size_type chunk_size = blocks(count);
+    if (!chunk_size) {
+      return reinterpret_cast<T*>(pool_);
+    }
+    size_type mask = 0;
+    size_type phase = 0;
+    if (alignment > block_size()) {
+      mask = (alignment >> trace_->block_shift) - 1;
+      phase = (alignment - reinterpret_cast<std::uintptr_t>(pool_) % alignment) % alignment;
+      phase >>= trace_->block_shift;
+    }
+    size_type total = trace_->limit >> trace_->block_shift;
+    size_type hint = start_hint(total);
+    size_type first = claim(chunk_size, mask, phase, hint, total);
+    if (first == pool_bitmap::npos && hint) {
+      first = claim(chunk_size, mask, phase, 0, total);
+    }
+    if (first == pool_bitmap::npos) {
+      throw std::bad_alloc();
+    }
+    trace_->allocd.fetch_add(chunk_size << trace_->block_shift, std::memory_order_relaxed);
+    return reinterpret_cast<T*>(pool_ + (first << trace_->block_shift));
+  }
+
+  void deallocate(T* ptr, size_type count) noexcept {
+    size_type chunk_size = blocks(count);
+    size_type offs = reinterpret_cast<uint8_t*>(ptr) - pool_;
+    if (offs >= trace_->limit || (offs & (block_size() - 1))) { return; }
+    offs >>= trace_->block_shift;
+    if (offs + chunk_size > (trace_->limit >> trace_->block_shift)) { return; }
+    for_each_word(offs, chunk_size, [](std::atomic<word_type>& w, word_type m) {
+      w.fetch_and(~m, std::memory_order_release);
+      return true;
+    });
+    trace_->allocd.fetch_sub(chunk_size << trace_->block_shift, std::memory_order_relaxed);
+  }
+
+  bool operator==(const concurrent_pool_allocator& other) const noexcept {
+    return trace_ == other.trace_;
+  }
+
+  bool operator!=(const concurrent_pool_allocator& other) const noexcept {
+    return trace_ != other.trace_;
+  }
+
+ private:
+  std::atomic<word_type>* state() const noexcept {
+    return reinterpret_cast<std::atomic<word_type>*>(trace_ + 1);
+  }
+
+  // Number of blocks occupied by count objects
+  size_type blocks(size_type count) const noexcept {
+    return (count*sizeof(T) + block_size() - 1) >> trace_->block_shift;
+  }
+
+  // Per thread starting point of the search, spreads threads over the pool
+  static size_type start_hint(size_type total) noexcept {
+    static std::atomic<size_type> threads{0};
+    thread_local size_type index = threads.fetch_add(1, std::memory_order_relaxed);
+    // Golden ratio hashing scatters consecutive thread indices
+    size_type scattered = (index*size_type(0x9E3779B97F4A7C15ull)) >> 32;
+    return (total > pool_bitmap::kWordBits) ?
+        (scattered % (total / pool_bitmap::kWordBits))*pool_bitmap::kWordBits :
+        0;
+  }
+
+  // Finds and claims a run of count blocks starting at or after from,
+  // returns npos if there is no such run
+  size_type claim(size_type count, size_type mask, size_type phase,
+                  size_type from, size_type total) noexcept {
+    while (true) {
+      size_type first = find(count, mask, phase, from, total);
+      if (first == pool_bitmap::npos) {
+        return first;
+      }
+      size_type conflict = try_claim(first, count);
+      if (conflict == pool_bitmap::npos) {
+        return first;
+      }
+      from = conflict;
+    }
+  }
+
+  // Atomically sets bits [pos, pos + count) word by word. On success returns
+  // npos, otherwise rolls back and returns the position to resume search at.
+  size_type try_claim(size_type pos, size_type count) noexcept {
+    size_type claimed = 0;
+    size_type conflict = pool_bitmap::npos;
+    for_each_word(pos, count, [&](std::atomic<word_type>& w, word_type m) {
+      word_type old = w.fetch_or(m, std::memory_order_acq_rel);
+      if (old & m) {
+        w.fetch_and(~(m & ~old), std::memory_order_relaxed);
+        conflict = (&w - state())*pool_bitmap::kWordBits;
+        return false;
+      }
+      ++claimed;
+      return true;
+    });
+    if (conflict == pool_bitmap::npos) {
+      return conflict;
+    }
+    size_type released = 0;
+    for_each_word(pos, count, [&](std::atomic<word_type>& w, word_type m) {
+      if (released++ == claimed) return false;
+      w.fetch_and(~m, std::memory_order_relaxed);
+      return true;
+    });
+    return (conflict > pos) ? conflict : pos + 1;
+  }
+
+  // Relaxed snapshot of the bitmap words for pool_bitmap::scan
+  struct word_view {
+    const std::atomic<word_type>* words;
+
+    word_type word(size_type i) const noexcept {
+      return words[i].load(std::memory_order_relaxed);
+    }
+
+    size_type zero_words(size_type first, size_type count, size_type limit) const noexcept {
+      size_type last = (first + limit < count) ? first + limit : count;
+      size_type i = first;
+      for (; i < last && !word(i); ++i) {}
+      return i - first;
+    }
+
+    size_type full_words(size_type first, size_type count) const noexcept {
+      size_type i = first;
+      for (; i < count && !~word(i); ++i) {}
+      return i - first;
+    }
+  };
+
+  // Run of count clear bits starting at or after from at a position equal to
+  // phase modulo mask + 1. There is no summary index to keep consistent
+  // between threads, so the search is a plain word scan.
+  size_type find(size_type count, size_type mask, size_type phase,
+                 size_type from, size_type total) const noexcept {
+    return pool_bitmap::scan(word_view{state()}, count, from, total, mask + 1, phase);
+  }
+
+  // Calls op(word, mask) for every word touched by [pos, pos + count) until
+  // op returns false
+  template <typename Op>
+  void for_each_word(size_type pos, size_type count, Op op) const noexcept {
+    constexpr size_type kBits = pool_bitmap::kWordBits;
+    if (!count) return;
+    size_type first = pos / kBits;
+    size_type last = (pos + count - 1) / kBits;
+    if (first == last) {
+      op(state()[first], pool_bitmap::mask(pos % kBits, (pos + count - 1) % kBits + 1));
+      return;
+    }
+    if (!op(state()[first], pool_bitmap::mask(pos % kBits, kBits))) return;
+    for (size_type i = first + 1; i < last; ++i) {
+      if (!op(state()[i], ~word_type(0))) return;
+    }
+    op(state()[last], pool_bitmap::mask(0, (pos + count - 1) % kBits + 1));
+  }
+
+  static constexpr size_type pool_alignment(size_type block_size) noexcept {
+    return (block_size > kPoolAlignment) ? block_size : kPoolAlignment;
+  }
+
+  // Offset of the pool from the start of the trace, bitmap lies in between
+  static constexpr size_type pool_offset(size_type blocks, size_type block_size) noexcept {
+    size_type align = pool_alignment(block_size);
+    size_type offs = sizeof(trace_type) + pool_bitmap::word_count(blocks)*sizeof(word_type);
+    return (offs + align - 1) / align * align;
+  }
+
+  trace_type* alloc_trace(std::size_t size, std::size_t block_size) {
+    if (!size) throw std::bad_alloc();
+    if (!block_size || (block_size & (block_size - 1))) {
+      throw std::invalid_argument("Pool block size must be a power of two");
+    }
+    std::size_t blocks = (size + block_size - 1) / block_size;
+    std::size_t trace_size = pool_offset(blocks, block_size) + blocks*block_size;
+    return reinterpret_cast<trace_type*>(
+        operator new(trace_size, std::align_val_t(pool_alignment(block_size))));
+  }
+
+  void free_trace() noexcept {
+    operator delete(trace_, std::align_val_t(pool_alignment(block_size())));
+  }
+
+  uint8_t* pool_;
+  trace_type* trace_;
+};
+
+template <typename T>
+void swap(concurrent_pool_allocator<T>& lhs, concurrent_pool_allocator<T>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_CONCURRENT_POOL_ALLOCATOR_H_
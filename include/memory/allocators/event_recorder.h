@@ -0,0 +1,279 @@
+#ifndef MEMORY_ALLOCATORS_EVENT_RECORDER_H_
+#define MEMORY_ALLOCATORS_EVENT_RECORDER_H_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Allocation event hooks compile to nothing unless MEMORY_ALLOC_EVENTS is
+// defined for the whole program (ALLOC_EVENTS option of the build)
+#if defined(MEMORY_ALLOC_EVENTS)
+#if defined(__cpp_lib_is_constant_evaluated)
+#define MEMORY_RECORD_EVENT(...)                        \
+  do {                                                  \
+    if (!std::is_constant_evaluated()) {                \
+      ::memory::event_recorder::record(__VA_ARGS__);    \
+    }                                                   \
+  } while (0)
+#else
+#define MEMORY_RECORD_EVENT(...) ::memory::event_recorder::record(__VA_ARGS__)
+#endif
+#else
+#define MEMORY_RECORD_EVENT(...) ((void)0)
+#endif
+
+namespace memory {
+// One record of allocation traffic, trace files hold them as is
+struct alloc_event {
+  enum kind_type : uint8_t {
+    kAllocate = 0,
+    // Block of size bytes at offset returned to its pool
+    kDeallocate = 1,
+    // Container moved to a buffer of size bytes from one of old_size bytes
+    kReallocate = 2,
+  };
+
+  // Nanoseconds since the recorder was opened
+  uint64_t time;
+  uint64_t size;
+  // Opaque key of the block within its pool: address of the block minus the
+  // address of the first segment of the pool, modulo 2^64. Segments below the
+  // first one wrap around. Zero for containers.
+  uint64_t offset;
+  // Size before a kReallocate, zero for other events
+  uint64_t old_size;
+  // Numbered in order of the first event of every thread
+  uint32_t thread;
+  // Pool the event comes from, zero for containers
+  uint16_t source;
+  uint8_t kind;
+  uint8_t reserved;
+};
+
+static_assert(sizeof(alloc_event) == 40, "alloc_event is a part of trace file format");
+
+// Process wide sink of allocation events. Every thread writes to a ring of
+// its own without locking; rings are drained into the trace file by flush(),
+// by close(), on thread exit and by the writing thread itself once its ring
+// is half full and the file is not busy. Events that find the ring full are
+// dropped and counted.
+//
+// Trace file is a header of kMagic, event size and a reserved word, followed
+// by alloc_event records in host byte order. Events of one thread appear in
+// order, events of different threads are interleaved in chunks.
+class event_recorder {
+ public:
+  static constexpr std::size_t kRingSize = 4096;
+  static constexpr char kMagic[8] = {'M', 'E', 'M', 'E', 'V', 'T', '2', '\0'};
+
+  // Starts writing events to path, truncating it. Returns false if the file
+  // cannot be opened.
+  static bool open(const char* path) {
+    state& s = global();
+    std::lock_guard<std::mutex> guard(s.lock);
+    close_file(s);
+    s.file = std::fopen(path, "wb");
+    if (!s.file) {
+      return false;
+    }
+    uint32_t header[2] = {sizeof(alloc_event), 0};
+    std::fwrite(kMagic, sizeof(kMagic), 1, s.file);
+    std::fwrite(header, sizeof(header), 1, s.file);
+    for (ring* r : s.rings) {
+      r->tail.store(r->head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+    s.dropped.store(0, std::memory_order_relaxed);
+    s.start = std::chrono::steady_clock::now();
+    s.active.store(true, std::memory_order_release);
+    return true;
+  }
+
+  // Writes out events recorded so far by every thread
+  static void flush() {
+    state& s = global();
+    std::lock_guard<std::mutex> guard(s.lock);
+    for (ring* r : s.rings) {
+      drain(s, *r);
+    }
+    if (s.file) {
+      std::fflush(s.file);
+    }
+  }
+
+  // Flushes and closes the file, events are ignored until the next open()
+  static void close() {
+    state& s = global();
+    std::lock_guard<std::mutex> guard(s.lock);
+    close_file(s);
+  }
+
+  static bool recording() noexcept {
+    return global().active.load(std::memory_order_relaxed);
+  }
+
+  // Number of events lost since open()
+  static std::size_t dropped() noexcept {
+    return global().dropped.load(std::memory_order_relaxed);
+  }
+
+  // Unique non-zero pool id, wraps around after 65535 pools
+  static uint16_t next_source() noexcept {
+    uint16_t res = global().sources.fetch_add(1, std::memory_order_relaxed);
+    return res ? res : global().sources.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static void record(uint8_t kind, uint64_t size, uint64_t offset, uint16_t source,
+                     uint64_t old_size = 0) noexcept {
+    state& s = global();
+    if (!s.active.load(std::memory_order_acquire)) {
+      return;
+    }
+    ring* r = local(s);
+    if (!r) {
+      s.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    std::size_t head = r->head.load(std::memory_order_relaxed);
+    std::size_t used = head - r->tail.load(std::memory_order_acquire);
+    if (used >= kRingSize / 2 && s.lock.try_lock()) {
+      drain(s, *r);
+      s.lock.unlock();
+      used = 0;
+    }
+    if (used == kRingSize) {
+      s.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto time = std::chrono::steady_clock::now() - s.start;
+    alloc_event& e = r->events[head % kRingSize];
+    e.time = std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+    e.size = size;
+    e.offset = offset;
+    e.old_size = old_size;
+    e.thread = r->thread;
+    e.source = source;
+    e.kind = kind;
+    e.reserved = 0;
+    r->head.store(head + 1, std::memory_order_release);
+  }
+
+  // Reads a trace file written by the recorder. Throws std::runtime_error if
+  // the file cannot be read or has a different format.
+  static std::vector<alloc_event> load(const char* path) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path, "rb"), std::fclose);
+    if (!file) {
+      throw std::runtime_error("Cannot open allocation trace");
+    }
+    char magic[sizeof(kMagic)];
+    uint32_t header[2];
+    if (std::fread(magic, sizeof(magic), 1, file.get()) != 1 ||
+        std::fread(header, sizeof(header), 1, file.get()) != 1 ||
+        std::memcmp(magic, kMagic, sizeof(kMagic)) || header[0] != sizeof(alloc_event)) {
+      throw std::runtime_error("Not an allocation trace");
+    }
+    std::vector<alloc_event> res;
+    alloc_event chunk[256];
+    std::size_t count;
+    while ((count = std::fread(chunk, sizeof(alloc_event), 256, file.get()))) {
+      res.insert(res.end(), chunk, chunk + count);
+    }
+    return res;
+  }
+
+ private:
+  // Single producer single consumer queue, the consumer holds state::lock
+  struct ring {
+    alloc_event events[kRingSize];
+    std::atomic<std::size_t> head{0};
+    std::atomic<std::size_t> tail{0};
+    uint32_t thread = 0;
+  };
+
+  struct state {
+    std::mutex lock;
+    std::FILE* file = nullptr;
+    std::atomic<bool> active{false};
+    std::chrono::steady_clock::time_point start;
+    std::vector<ring*> rings;
+    std::atomic<std::size_t> dropped{0};
+    std::atomic<uint32_t> threads{0};
+    std::atomic<uint16_t> sources{1};
+
+    ~state() {
+      close_file(*this);
+    }
+  };
+
+  // Registers the ring of the calling thread, drains it on thread exit
+  struct ring_owner {
+    ring* ptr = nullptr;
+
+    ~ring_owner() {
+      if (ptr) {
+        state& s = global();
+        std::lock_guard<std::mutex> guard(s.lock);
+        drain(s, *ptr);
+        s.rings.erase(std::find(s.rings.begin(), s.rings.end(), ptr));
+        delete ptr;
+      }
+    }
+  };
+
+  static state& global() noexcept {
+    static state s;
+    return s;
+  }
+
+  // Ring of the calling thread, allocated on its first event; null if it
+  // cannot be allocated
+  static ring* local(state& s) noexcept {
+    thread_local ring_owner owner;
+    if (!owner.ptr) {
+      try {
+        std::unique_ptr<ring> r(new ring);
+        r->thread = s.threads.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> guard(s.lock);
+        s.rings.push_back(r.get());
+        owner.ptr = r.release();
+      } catch (...) {
+        return nullptr;
+      }
+    }
+    return owner.ptr;
+  }
+
+  // s.lock must be held
+  static void drain(state& s, ring& r) noexcept {
+    std::size_t tail = r.tail.load(std::memory_order_relaxed);
+    std::size_t head = r.head.load(std::memory_order_acquire);
+    while (s.file && tail != head) {
+      std::size_t first = tail % kRingSize;
+      std::size_t count = std::min(head - tail, kRingSize - first);
+      std::fwrite(r.events + first, sizeof(alloc_event), count, s.file);
+      tail += count;
+    }
+    r.tail.store(head, std::memory_order_release);
+  }
+
+  // s.lock must be held
+  static void close_file(state& s) noexcept {
+    s.active.store(false, std::memory_order_relaxed);
+    for (ring* r : s.rings) {
+      drain(s, *r);
+    }
+    if (s.file) {
+      std::fclose(s.file);
+      s.file = nullptr;
+    }
+  }
+};
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_EVENT_RECORDER_H_
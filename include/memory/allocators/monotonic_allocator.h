@@ -0,0 +1,206 @@
+#ifndef MEMORY_ALLOCATORS_MONOTONIC_ALLOCATOR_H_
+#define MEMORY_ALLOCATORS_MONOTONIC_ALLOCATOR_H_
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+namespace memory {
+// No general requirements on type T
+//
+// Arena allocator: allocate() bumps a pointer inside the current block,
+// deallocate() does nothing and release() frees everything at once. Blocks
+// are taken from the global heap when the current one runs out, each twice
+// the size of the previous one, and are chained so that release() can walk
+// them. The unused tail of a block is lost once a new block is started.
+//
+// Arena may start in a caller supplied buffer, which is never freed by the
+// allocator. allocd() counts bytes handed out since the last release(),
+// remaining() is the free space in the current block.
+template <typename T>
+class monotonic_allocator {
+  template <typename U>
+  friend class monotonic_allocator;
+
+  struct block {
+    block* prev;
+    std::size_t size;
+  };
+
+  struct trace_type {
+    uint8_t* cursor;
+    uint8_t* end;
+    block* head;
+    uint8_t* buffer;
+    std::size_t buffer_size;
+    std::size_t block_size;
+    std::size_t next_size;
+    std::size_t allocd;
+    std::size_t ref_count;
+  };
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::true_type;
+
+  static constexpr size_type kDefaultBlockSize = 4096;
+
+  // block_size is the size of the first block taken from the heap, it is not
+  // taken before the first allocation
+  explicit monotonic_allocator(size_type block_size = kDefaultBlockSize)
+      : monotonic_allocator(nullptr, 0, block_size) {}
+
+  // buffer must outlive the allocator and all of its copies
+  monotonic_allocator(void* buffer, size_type size, size_type block_size = kDefaultBlockSize)
+      : trace_(new trace_type{static_cast<uint8_t*>(buffer), static_cast<uint8_t*>(buffer) + size,
+                              nullptr, static_cast<uint8_t*>(buffer), size,
+                              block_size ? block_size : kDefaultBlockSize, 0, 0, 1}) {
+    trace_->next_size = trace_->block_size;
+  }
+
+  template <typename U>
+  monotonic_allocator(const monotonic_allocator<U>& other) noexcept
+      : trace_(reinterpret_cast<trace_type*>(other.trace_)) {
+    ++trace_->ref_count;
+  }
+
+  template <typename U>
+  monotonic_allocator(monotonic_allocator<U>&& other) noexcept : monotonic_allocator(other) {}
+
+  monotonic_allocator(const monotonic_allocator& other) noexcept : trace_(other.trace_) {
+    ++trace_->ref_count;
+  }
+
+  monotonic_allocator(monotonic_allocator&& other) noexcept : monotonic_allocator(other) {}
+
+  template <typename U>
+  monotonic_allocator& operator=(const monotonic_allocator<U>& other) = delete;
+
+  template <typename U>
+  monotonic_allocator& operator=(monotonic_allocator<U>&&) = delete;
+
+  monotonic_allocator& operator=(const monotonic_allocator& other) = delete;
+
+  monotonic_allocator& operator=(monotonic_allocator&&) = delete;
+
+  virtual ~monotonic_allocator() {
+    if (!--trace_->ref_count) {
+      free_blocks();
+      delete trace_;
+    }
+  }
+
+  //==============================================================================
+
+  size_type max_size() const noexcept {
+    return std::numeric_limits<size_type>::max() / 4 / sizeof(T);
+  }
+
+  size_type allocd() const noexcept {
+    return trace_->allocd;
+  }
+
+  size_type remaining() const noexcept {
+    return trace_->end - trace_->cursor;
+  }
+
+  // Frees every block, memory handed out before is no longer valid
+  void release() noexcept {
+    free_blocks();
+    trace_->cursor = trace_->buffer;
+    trace_->end = trace_->buffer + trace_->buffer_size;
+    trace_->next_size = trace_->block_size;
+    trace_->allocd = 0;
+  }
+  //==============================================================================
+
+  void swap(monotonic_allocator& other) noexcept {
+    std::swap(trace_, other.trace_);
+  }
+
+  T* allocate(size_type count) {
+    return allocate(count, alignof(T));
+  }
+
+  // alignment must be a power of two
+  T* allocate(size_type count, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    if (count > max_size()) {
+      throw std::bad_alloc();
+    }
+    size_type bytes = count*sizeof(T);
+    uint8_t* res = align(trace_->cursor, alignment);
+    size_type avail = trace_->end - trace_->cursor;
+    size_type pad = res - trace_->cursor;
+    if (!trace_->cursor || pad > avail || bytes > avail - pad) {
+      res = align(grow(bytes, alignment), alignment);
+    }
+    trace_->cursor = res + bytes;
+    trace_->allocd += bytes;
+    return reinterpret_cast<T*>(res);
+  }
+
+  void deallocate(T*, size_type) noexcept {}
+
+  bool operator==(const monotonic_allocator& other) const noexcept {
+    return trace_ == other.trace_;
+  }
+
+  bool operator!=(const monotonic_allocator& other) const noexcept {
+    return trace_ != other.trace_;
+  }
+
+ private:
+  static uint8_t* align(uint8_t* ptr, size_type alignment) noexcept {
+    std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(ptr);
+    return ptr + ((alignment - addr % alignment) % alignment);
+  }
+
+  // Starts a new block with room for bytes at alignment, returns its first
+  // free byte
+  uint8_t* grow(size_type bytes, size_type alignment) {
+    constexpr size_type limit = std::numeric_limits<size_type>::max() / 2 - sizeof(block);
+    if (bytes > limit || alignment > limit - bytes) {
+      throw std::bad_alloc();
+    }
+    bytes += alignment;
+    size_type size = trace_->next_size;
+    while (size < bytes + sizeof(block)) {
+      size *= 2;
+    }
+    block* b = static_cast<block*>(operator new(size));
+    b->prev = trace_->head;
+    b->size = size;
+    trace_->head = b;
+    trace_->next_size = size*2;
+    trace_->cursor = reinterpret_cast<uint8_t*>(b + 1);
+    trace_->end = reinterpret_cast<uint8_t*>(b) + size;
+    return trace_->cursor;
+  }
+
+  void free_blocks() noexcept {
+    while (trace_->head) {
+      block* prev = trace_->head->prev;
+      operator delete(trace_->head);
+      trace_->head = prev;
+    }
+  }
+
+  trace_type* trace_;
+};
+
+template <typename T>
+void swap(monotonic_allocator<T>& lhs, monotonic_allocator<T>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_MONOTONIC_ALLOCATOR_H_
@@ -0,0 +1,167 @@
+#ifndef MEMORY_ALLOCATORS_PAGE_STORAGE_H_
+#define MEMORY_ALLOCATORS_PAGE_STORAGE_H_
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>   // mmap, munmap, madvise, mlock
+#include <unistd.h>     // sysconf
+#define MEMORY_PAGE_STORAGE_MMAP
+#endif
+
+namespace memory {
+// Anonymous page mappings used as pool storage. Fresh mappings are backed by
+// the shared zero page until written, so nothing is faulted in up front.
+//
+// Huge mappings try MAP_HUGETLB first and fall back to regular pages aligned
+// to kHugePageSize with MADV_HUGEPAGE, so transparent huge pages can back
+// them. On platforms without mmap storage comes from aligned operator new.
+class page_storage {
+ public:
+  static constexpr std::size_t kHugePageSize = std::size_t(1) << 21;
+
+  static std::size_t page_size() noexcept {
+#if defined(MEMORY_PAGE_STORAGE_MMAP)
+    static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+  }
+
+  // Granularity of mappings, size passed to map() is rounded up to it
+  static std::size_t granularity(bool huge) noexcept {
+    return huge ? kHugePageSize : page_size();
+  }
+
+  // Maps at least size bytes aligned to alignment, size is updated to the
+  // mapped size. alignment must be a power of two. Populated mappings are
+  // faulted in by the system right away. Throws std::bad_alloc.
+  static void* map(std::size_t& size, std::size_t alignment, bool huge, bool populate = false) {
+    std::size_t unit = granularity(huge);
+    size = (size + unit - 1) / unit * unit;
+    if (alignment < unit) {
+      alignment = unit;
+    }
+#if defined(MEMORY_PAGE_STORAGE_MMAP)
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_POPULATE)
+    if (populate) {
+      flags |= MAP_POPULATE;
+    }
+#endif
+#if defined(MAP_HUGETLB)
+    if (huge && alignment == unit) {
+      void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+      if (ptr != MAP_FAILED) {
+        return ptr;
+      }
+    }
+#endif
+    // Over-map and cut both ends to get the alignment
+    std::size_t span = size + alignment - page_size();
+    void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (raw == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    uint8_t* first = static_cast<uint8_t*>(raw);
+    uint8_t* res = first + (alignment - reinterpret_cast<std::uintptr_t>(first) % alignment) % alignment;
+    if (res != first) {
+      munmap(first, res - first);
+    }
+    if (res + size != first + span) {
+      munmap(res + size, first + span - res - size);
+    }
+#if defined(MADV_HUGEPAGE)
+    if (huge) {
+      madvise(res, size, MADV_HUGEPAGE);
+    }
+#endif
+    return res;
+#else
+    (void)populate;
+    return operator new(size, std::align_val_t(alignment));
+#endif
+  }
+
+  // Faults in pages in [ptr, ptr + size) for writing without changing their
+  // contents. Returns false if the system cannot do it, pages have to be
+  // touched by hand then.
+  static bool populate(void* ptr, std::size_t size) noexcept {
+#if defined(MEMORY_PAGE_STORAGE_MMAP) && defined(MADV_POPULATE_WRITE)
+    return !madvise(align_down(ptr), size + offset(ptr), MADV_POPULATE_WRITE);
+#else
+    (void)ptr;
+    (void)size;
+    return false;
+#endif
+  }
+
+  // Keeps pages in [ptr, ptr + size) resident, returns false on failure,
+  // e.g. when RLIMIT_MEMLOCK is exceeded
+  static bool lock(void* ptr, std::size_t size) noexcept {
+#if defined(MEMORY_PAGE_STORAGE_MMAP)
+    return !mlock(ptr, size);
+#else
+    (void)ptr;
+    (void)size;
+    return false;
+#endif
+  }
+
+  static void unlock(void* ptr, std::size_t size) noexcept {
+#if defined(MEMORY_PAGE_STORAGE_MMAP)
+    munlock(ptr, size);
+#else
+    (void)ptr;
+    (void)size;
+#endif
+  }
+
+  // Hands pages in [ptr, ptr + size) back to the system, their contents are
+  // lost. Lazy discard lets the system reclaim them only under memory
+  // pressure, which is cheaper if they are reused soon. Returns false if
+  // pages could not be discarded.
+  static bool discard(void* ptr, std::size_t size, bool lazy) noexcept {
+#if defined(MEMORY_PAGE_STORAGE_MMAP)
+#if defined(MADV_FREE)
+    if (lazy && !madvise(ptr, size, MADV_FREE)) {
+      return true;
+    }
+#else
+    (void)lazy;
+#endif
+    return !madvise(ptr, size, MADV_DONTNEED);
+#else
+    (void)ptr;
+    (void)size;
+    (void)lazy;
+    return false;
+#endif
+  }
+
+  // size and alignment must be the ones returned from and passed to map()
+  static void unmap(void* ptr, std::size_t size, std::size_t alignment, bool huge) noexcept {
+#if defined(MEMORY_PAGE_STORAGE_MMAP)
+    (void)alignment;
+    (void)huge;
+    munmap(ptr, size);
+#else
+    std::size_t unit = granularity(huge);
+    operator delete(ptr, std::align_val_t((alignment < unit) ? unit : alignment));
+#endif
+  }
+
+ private:
+  static std::size_t offset(void* ptr) noexcept {
+    return reinterpret_cast<std::uintptr_t>(ptr) % page_size();
+  }
+
+  static void* align_down(void* ptr) noexcept {
+    return static_cast<uint8_t*>(ptr) - offset(ptr);
+  }
+};
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_PAGE_STORAGE_H_
@@ -1,11 +1,25 @@
 #ifndef MEMORY_ALLOCATORS_POOL_ALLOCATOR_H_
 #define MEMORY_ALLOCATORS_POOL_ALLOCATOR_H_
-#include <cstring>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <new>
 #include <type_traits>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
-#include "../iterators/bit_iterator.h"
+#include "allocation_result.h"
+#include "event_recorder.h"
+#include "page_storage.h"
+#include "pool_bitmap.h"
+#include "pool_checks.h"
+#include "pool_placement.h"
 
 #if __cplusplus >= 202002L
 #define MEMORY_CPP20CONSTEXPR constexpr 
@@ -14,16 +28,157 @@
 #endif  // 202002L
 
 namespace memory {
+// Construction parameters of pool_allocator
+struct pool_options {
+  // Granularity of the pool, must be a power of two
+  std::size_t block_size = 1;
+  // Chain a new segment instead of throwing std::bad_alloc once the pool is full
+  bool growable = false;
+  // Size of every new segment relative to the previous one, at least 1
+  std::size_t growth_factor = 2;
+  // Free segments added by growth as soon as they become empty
+  bool release_empty = false;
+  // Source of segment storage, global operator new if null. Must outlive the
+  // pool.
+  std::pmr::memory_resource* upstream = nullptr;
+  // Take segments straight from anonymous page mappings, bitmaps get mappings
+  // of their own. Segment size is rounded up to whole pages.
+  bool mapped = false;
+  // Back mapped segments with huge pages where possible, implies mapped
+  bool huge_pages = false;
+  // Number of trim() calls a free page of a mapped segment has to survive
+  // before it is given back to the system, at least 1
+  std::size_t trim_delay = 1;
+  // Give pages back with MADV_FREE instead of MADV_DONTNEED
+  bool lazy_trim = false;
+  // Fault in every segment when it is created, see pool_allocator::warm_up()
+  bool prefault = false;
+  // Number of threads faulting in a segment, at least 1
+  std::size_t prefault_threads = 1;
+  // Lock prefaulted segments in memory
+  bool lock_pages = false;
+  // Count allocations for pool_allocator::stats()
+  bool stats = false;
+};
+
+// Snapshot of pool_allocator statistics. Counters stay zero unless
+// pool_options::stats is set, layout figures are always filled in.
+struct pool_stats {
+  // Histogram bucket i > 0 counts values in [2^(i - 1), 2^i), bucket 0 counts
+  // zeros and the last bucket everything beyond
+  static constexpr std::size_t kBuckets = 32;
+
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+  // Allocations that threw std::bad_alloc
+  std::size_t failures = 0;
+  // Highest allocd() seen
+  std::size_t high_water = 0;
+  // Requested sizes in bytes
+  std::array<std::size_t, kBuckets> sizes{};
+  // Bitmap summary nodes and words, or placement index entries, looked at by
+  // the search of every allocation over all segments it tried
+  std::array<std::size_t, kBuckets> scans{};
+
+  std::size_t free_bytes = 0;
+  // Length of the longest free run in bytes
+  std::size_t largest_free = 0;
+  // Number of free runs over all segments
+  std::size_t free_extents = 0;
+  // 1 - largest_free / free_bytes, zero for a full pool. Close to one means
+  // free space is there but too scattered to serve large requests.
+  double fragmentation = 0;
+};
+
+// Outcome of pool_allocator::warm_up()
+struct pool_warm_up {
+  // Wall time spent faulting in and locking the pool
+  std::chrono::nanoseconds elapsed{0};
+  // Size of the faulted in part of the pool
+  std::size_t bytes = 0;
+  // Whether all of it was locked in memory
+  bool locked = false;
+};
+
 // No general requirements on type T
-template <typename T>
-class pool_allocator {
-  template <typename U>
+//
+// Pool is tracked in blocks of block_size bytes, one bitmap bit per block.
+// Every allocation is rounded up to whole blocks, allocd() and remaining()
+// are still reported in bytes.
+//
+// Pool storage is aligned to kPoolAlignment (or to block_size if greater),
+// allocations are aligned to alignof(T) unless stronger alignment is requested
+// explicitly. Only aligned block positions are searched, so no space is lost
+// to padding.
+//
+// Growable pool is a chain of segments, each with its own bitmap. Segments are
+// kept sorted by address, so deallocate finds the owner in O(log segments).
+// The first segment lives as long as the pool, remaining() reports free space
+// of the segments allocated so far.
+//
+// Placement chooses where a run is taken from, see pool_placement.h. Checks
+// chooses the diagnostics, see pool_checks.h: release_checks drops the vtable,
+// the leak scan and pointer validation, debug_checks adds fill patterns,
+// double free detection and guard canaries.
+//
+// allocate_n() carves many equal blocks out of free runs in a single pass over
+// each bitmap, lowest addresses first whatever the Placement. deallocate_n()
+// clears blocks adjacent in memory and in the array at once.
+//
+// trim() gives free pages of mapped segments back to the system. Every page
+// ages by one with each trim() call it stays free and is released once its
+// age reaches trim_delay, so pages freed and reused between two calls are
+// never released. Huge page segments are trimmed in whole huge pages.
+//
+// warm_up() faults in the whole pool up front, so first allocations do not
+// pay for page faults. With options.prefault every segment is warmed up as it
+// is created, mapped segments are then mapped with MAP_POPULATE.
+//
+// Statistics counters are relaxed atomics, so stats() may be read from any
+// thread while the pool is in use.
+//
+// With MEMORY_ALLOC_EVENTS defined every allocation and deallocation is sent
+// to event_recorder, see event_recorder.h.
+template <typename T, typename Placement = first_fit, typename Checks = default_checks>
+class pool_allocator : public Checks::base {
+  template <typename U, typename P, typename C>
   friend class pool_allocator;
 
+  // Bitmap lies in front of the pool in the same allocation unless the pool
+  // is mapped
+  struct segment {
+    uint8_t* pool;
+    std::size_t size;
+    void* storage;
+    typename Placement::state placement;
+    // Trim age of every page of a mapped segment
+    std::vector<uint8_t> pages;
+  };
+
+  static constexpr uint8_t kReleased = 0xff;
+
+  struct counters {
+    std::atomic<std::size_t> allocations{0};
+    std::atomic<std::size_t> deallocations{0};
+    std::atomic<std::size_t> failures{0};
+    std::atomic<std::size_t> high_water{0};
+    std::array<std::atomic<std::size_t>, pool_stats::kBuckets> sizes{};
+    std::array<std::atomic<std::size_t>, pool_stats::kBuckets> scans{};
+  };
+
   struct trace_type {
     std::size_t allocd;
     std::size_t limit;
     std::size_t ref_count;
+    std::size_t block_shift;
+    pool_options options;
+    std::size_t next_size;
+    uint8_t* primary;
+    std::vector<segment> segments;
+    pool_warm_up last_warm_up;
+    bool locked;
+    std::unique_ptr<counters> stats;
+    uint16_t source;
   };
 
  public:
@@ -34,26 +189,45 @@ class pool_allocator {
   using propagate_on_container_move_assignment = std::false_type;
   using propagate_on_container_swap = std::true_type;
 
-  MEMORY_CPP20CONSTEXPR explicit pool_allocator(size_type size) 
-      : trace_(alloc_trace(size)) {
-    pool_ = state() + (size + 7)/8;
-    trace_->allocd = 0;
-    trace_->limit = size;
-    trace_->ref_count = 1;
+  static constexpr size_type kPoolAlignment = 64;
+
+  // block_size must be a power of two, size is rounded up to whole blocks
+  MEMORY_CPP20CONSTEXPR explicit pool_allocator(size_type size, size_type block_size = 1)
+      : pool_allocator(size, pool_options{block_size}) {}
+
+  // size is the size of the first segment if options.growable is set
+  MEMORY_CPP20CONSTEXPR pool_allocator(size_type size, const pool_options& options)
+      : trace_(alloc_trace(size, options)) {
+    try {
+      if (options.stats) {
+        trace_->stats = std::make_unique<counters>();
+      }
+#if defined(MEMORY_ALLOC_EVENTS)
+      trace_->source = event_recorder::next_source();
+#endif
+      auto start = std::chrono::steady_clock::now();
+      trace_->primary = grow(size).pool;
+      if (options.prefault) {
+        trace_->last_warm_up.elapsed = std::chrono::steady_clock::now() - start;
+      }
+    } catch (...) {
+      delete trace_;
+      throw;
+    }
   }
 
   template <typename U>
-  MEMORY_CPP20CONSTEXPR pool_allocator(const pool_allocator<U>& other) noexcept
-      : pool_(other.pool_), trace_(reinterpret_cast<trace_type*>(other.trace_)) {
+  MEMORY_CPP20CONSTEXPR pool_allocator(const pool_allocator<U, Placement, Checks>& other) noexcept
+      : trace_(reinterpret_cast<trace_type*>(other.trace_)) {
     ++trace_->ref_count;
   }
 
   template <typename U>
-  MEMORY_CPP20CONSTEXPR pool_allocator(pool_allocator<U>&& other) noexcept
+  MEMORY_CPP20CONSTEXPR pool_allocator(pool_allocator<U, Placement, Checks>&& other) noexcept
       : pool_allocator(other) {} 
 
   MEMORY_CPP20CONSTEXPR pool_allocator(const pool_allocator& other) noexcept
-      : pool_(other.pool_), trace_(reinterpret_cast<trace_type*>(other.trace_)) {
+      : trace_(other.trace_) {
     ++trace_->ref_count;
   }
 
@@ -61,31 +235,39 @@ class pool_allocator {
       : pool_allocator(other) {}
 
   template <typename U>
-  pool_allocator& operator=(const pool_allocator<U>& other) = delete;
+  pool_allocator& operator=(const pool_allocator<U, Placement, Checks>& other) = delete;
 
   template <typename U>
-  pool_allocator& operator=(pool_allocator<U>&&) = delete;
+  pool_allocator& operator=(pool_allocator<U, Placement, Checks>&&) = delete;
 
   pool_allocator& operator=(const pool_allocator& other) = delete;
 
   pool_allocator& operator=(pool_allocator&&) = delete;
 
-  MEMORY_CPP20CONSTEXPR virtual ~pool_allocator() noexcept(false) {
+  MEMORY_CPP20CONSTEXPR ~pool_allocator() noexcept(!Checks::kLeakScan) {
     --trace_->ref_count;
     if (!trace_->ref_count) {
-      for (uint8_t *p = state(); p != pool_; ++p) {
-      if (*p) {
-        operator delete(trace_);
-        throw std::runtime_error("Memory leak detected: attempting to destroy pool allocator that has memory being used and not dealloc'd'");  // AOAOOOAOAOAOOAOAOAOAAOAO
+      if constexpr (Checks::kLeakScan) {
+        bool leaked = false;
+        for (const segment& seg : trace_->segments) {
+          leaked |= !bitmap(seg).none();
+        }
+        free_trace();
+        if (leaked) {
+          throw std::runtime_error("Memory leak detected: attempting to destroy pool allocator that has memory being used and not dealloc'd'");  // AOAOOOAOAOAOOAOAOAOAAOAO
+        }
+      } else {
+        free_trace();
       }
     }
-      operator delete(trace_);
-    }
   };
 
   //==============================================================================
 
   MEMORY_CPP20CONSTEXPR size_type max_size() const noexcept {
+    if (trace_->options.growable) {
+      return std::numeric_limits<size_type>::max() / 2 / sizeof(T);
+    }
     return trace_->limit / sizeof(T);
   }
 
@@ -96,41 +278,236 @@ class pool_allocator {
   MEMORY_CPP20CONSTEXPR size_type remaining() const noexcept {
     return trace_->limit - trace_->allocd;
   }
+
+  MEMORY_CPP20CONSTEXPR size_type block_size() const noexcept {
+    return size_type(1) << trace_->block_shift;
+  }
+
+  MEMORY_CPP20CONSTEXPR size_type segments() const noexcept {
+    return trace_->segments.size();
+  }
+
+  // Length of the longest free run in bytes
+  MEMORY_CPP20CONSTEXPR size_type largest_free() const noexcept {
+    size_type res = 0;
+    for (const segment& seg : trace_->segments) {
+      res = std::max(res, bitmap(seg).longest());
+    }
+    return res << trace_->block_shift;
+  }
+
+  // Layout figures walk every bitmap, so this takes time linear in pool size
+  pool_stats stats() const noexcept {
+    pool_stats res;
+    if (const counters* c = trace_->stats.get()) {
+      res.allocations = c->allocations.load(std::memory_order_relaxed);
+      res.deallocations = c->deallocations.load(std::memory_order_relaxed);
+      res.failures = c->failures.load(std::memory_order_relaxed);
+      res.high_water = c->high_water.load(std::memory_order_relaxed);
+      for (size_type i = 0; i < pool_stats::kBuckets; ++i) {
+        res.sizes[i] = c->sizes[i].load(std::memory_order_relaxed);
+        res.scans[i] = c->scans[i].load(std::memory_order_relaxed);
+      }
+    }
+    for (const segment& seg : trace_->segments) {
+      res.largest_free = std::max(res.largest_free, bitmap(seg).longest());
+      res.free_extents += bitmap(seg).runs();
+    }
+    res.largest_free <<= trace_->block_shift;
+    res.free_bytes = remaining();
+    if (res.free_bytes) {
+      res.fragmentation = double(res.free_bytes - res.largest_free) / double(res.free_bytes);
+    }
+    return res;
+  }
+
+  // Ages free pages of mapped segments and releases those that have been free
+  // for trim_delay calls. Returns number of bytes released by this call.
+  size_type trim() noexcept {
+    size_type res = 0;
+    for (segment& seg : trace_->segments) {
+      res += trim(seg);
+    }
+    return res;
+  }
+
+  // Faults in every page of the pool using up to threads threads and locks
+  // them in memory if lock is set. Contents of the pool are preserved. Must not
+  // run concurrently with any other use of the pool.
+  pool_warm_up warm_up(size_type threads = 1, bool lock = false) {
+    auto start = std::chrono::steady_clock::now();
+    pool_warm_up res;
+    res.locked = lock;
+    for (segment& seg : trace_->segments) {
+      pool_warm_up part = warm_up(seg, threads, lock);
+      res.bytes += part.bytes;
+      res.locked &= part.locked;
+    }
+    res.elapsed = std::chrono::steady_clock::now() - start;
+    trace_->last_warm_up = res;
+    return res;
+  }
+
+  // Report of the last warm-up, including those done by options.prefault.
+  // Warm-up done at construction also counts the time to set the pool up.
+  pool_warm_up last_warm_up() const noexcept {
+    return trace_->last_warm_up;
+  }
   //==============================================================================
 
   MEMORY_CPP20CONSTEXPR void swap(pool_allocator& other) noexcept {
-    if (trace_ != other.trace_) {
-      std::swap(trace_, other.trace_);
-      std::swap(pool_, other.pool_);
-    }
+    std::swap(trace_, other.trace_);
   }
 
   MEMORY_CPP20CONSTEXPR T* allocate(size_type count) {
-    size_type chunk_size = count * sizeof(T);
-    bit_iterator first(state());
-    bit_iterator last = first;
-    bit_iterator end(state(), trace_->limit);
-    for (; last != end && last.position() - first.position() < chunk_size; ++last) {
-      if (*last) {
-        ++first;
+    return allocate(count, alignof(T));
+  }
+
+  // alignment must be a power of two
+  MEMORY_CPP20CONSTEXPR T* allocate(size_type count, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    size_type chunk_size = blocks(count);
+    size_type visited = 0;
+    for (segment& seg : trace_->segments) {
+      size_type first = find(seg, chunk_size, alignment, visited);
+      if (first != pool_bitmap::npos) {
+        T* res = claim(seg, first, chunk_size);
+        count_allocation(res, count, visited);
+        return res;
       }
     }
-    if (last.position() - first.position() < chunk_size) {
-      throw std::bad_alloc();  // write own bad_alloc?
+    try {
+      if (!trace_->options.growable) {
+        throw std::bad_alloc();  // write own bad_alloc?
+      }
+      size_type needed = chunk_size << trace_->block_shift;
+      if (alignment > pool_alignment(block_size())) {
+        needed += alignment;
+      }
+      segment& seg = grow(needed);
+      T* res = claim(seg, find(seg, chunk_size, alignment, visited), chunk_size);
+      count_allocation(res, count, visited);
+      return res;
+    } catch (const std::bad_alloc&) {
+      if (trace_->stats) {
+        trace_->stats->failures.fetch_add(1, std::memory_order_relaxed);
+      }
+      throw;
     }
-    for (bit_iterator i = first; i != last; i.flip(), ++i) {}
-    trace_->allocd += chunk_size;
-    return reinterpret_cast<T*>(pool_ + first.position());
+  }
+
+  // Same as allocate(count), count of the result covers whole blocks. Checks
+  // see the count asked for, so guards start right after it and deallocating
+  // with either count passes them.
+  MEMORY_CPP20CONSTEXPR allocation_result<T*> allocate_at_least(size_type count) {
+    size_type room = (blocks(count) << trace_->block_shift) - Checks::kGuard;
+    return {allocate(count), std::max(count, room / sizeof(T))};
   }
 
   MEMORY_CPP20CONSTEXPR void deallocate(T* ptr, size_type count) noexcept {
-    size_type chunk_size = count * sizeof(T);
-    int64_t offs = reinterpret_cast<uint8_t*>(ptr) - pool_;
-    if (offs > trace_->limit) { return;}
-    bit_iterator first(state(), offs);
-    for (size_type i = 0; i < chunk_size; first.flip(), ++first, ++i) {}
-    trace_->allocd -= chunk_size;
-   }
+    release(reinterpret_cast<uint8_t*>(ptr), blocks(count), 1, count);
+  }
+
+  // Grows the block at ptr from old_count to new_count objects without
+  // moving it if the blocks right after it are free. Returns false and
+  // leaves the block as is otherwise; blocks are never shrunk.
+  bool try_expand(T* ptr, size_type old_count, size_type new_count) noexcept {
+    size_type old_size = blocks(old_count);
+    size_type new_size = blocks(new_count);
+    if (new_count > max_size() || new_size < old_size) { return false; }
+    uint8_t* p = reinterpret_cast<uint8_t*>(ptr);
+    Checks::resized(p, old_count*sizeof(T), old_size << trace_->block_shift);
+    if (new_size > old_size) {
+      auto seg = owner(p);
+      if (seg == trace_->segments.end()) { return false; }
+      size_type end = ((p - seg->pool) >> trace_->block_shift) + old_size;
+      if (!bitmap(*seg).none(end, new_size - old_size)) { return false; }
+      try {
+        claim(*seg, end, new_size - old_size);
+      } catch (...) {
+        return false;
+      }
+      MEMORY_RECORD_EVENT(alloc_event::kDeallocate, old_count*sizeof(T), event_offset(p),
+                          trace_->source);
+      MEMORY_RECORD_EVENT(alloc_event::kAllocate, new_count*sizeof(T), event_offset(p),
+                          trace_->source);
+      counters* c = trace_->stats.get();
+      if (c && trace_->allocd > c->high_water.load(std::memory_order_relaxed)) {
+        c->high_water.store(trace_->allocd, std::memory_order_relaxed);
+      }
+    }
+    size_type from = std::min(old_count, new_count)*sizeof(T);
+    Checks::allocated(p + from, new_count*sizeof(T) - from,
+                      (new_size << trace_->block_shift) - from);
+    return true;
+  }
+
+  // Allocates n blocks of count objects each and stores them in out. Either
+  // every block is allocated or std::bad_alloc is thrown and none is.
+  void allocate_n(T** out, size_type n, size_type count = 1) {
+    size_type chunk_size = blocks(count);
+    size_type done = 0;
+    try {
+      if (!chunk_size) {
+        for (; done < n; ++done) {
+          out[done] = allocate(count);
+        }
+        return;
+      }
+      for (size_type i = 0; i < trace_->segments.size() && done < n; ++i) {
+        carve(trace_->segments[i], out, n, count, done);
+      }
+      while (done < n) {
+        if (!trace_->options.growable) {
+          throw std::bad_alloc();
+        }
+        size_type step = std::max<size_type>(alignof(T) >> trace_->block_shift, 1);
+        size_type bytes = ((chunk_size + step - 1) / step * step) << trace_->block_shift;
+        if (n - done > std::numeric_limits<size_type>::max() / 4 / bytes) {
+          throw std::bad_alloc();
+        }
+        size_type needed = (n - done)*bytes;
+        if (alignof(T) > pool_alignment(block_size())) {
+          needed += alignof(T);
+        }
+        size_type before = done;
+        carve(grow(needed), out, n, count, done);
+        if (done == before) {
+          throw std::bad_alloc();
+        }
+      }
+    } catch (...) {
+      deallocate_n(out, done, count);
+      // allocate() counts its own failures
+      if (trace_->stats && chunk_size) {
+        trace_->stats->failures.fetch_add(1, std::memory_order_relaxed);
+      }
+      throw;
+    }
+  }
+
+  // Frees n blocks of count objects each. Runs of pointers to consecutive
+  // blocks, as returned by allocate_n(), are freed at once.
+  void deallocate_n(T* const* ptrs, size_type n, size_type count = 1) noexcept {
+    size_type chunk_size = blocks(count);
+    size_type bytes = chunk_size << trace_->block_shift;
+    for (size_type i = 0; i < n;) {
+      uint8_t* first = reinterpret_cast<uint8_t*>(ptrs[i]);
+      // A run ends with its segment, the next one may be mapped right after it
+      size_type room = n;
+      auto seg = owner(first);
+      if (first && bytes && seg != trace_->segments.end()) {
+        room = (seg->pool + seg->size - first) / bytes;
+      }
+      size_type j = i + 1;
+      for (; j < n && j - i < room &&
+             reinterpret_cast<uint8_t*>(ptrs[j]) == first + (j - i)*bytes; ++j) {}
+      release(first, chunk_size, j - i, count);
+      i = j;
+    }
+  }
 
   MEMORY_CPP20CONSTEXPR bool operator==(const pool_allocator& other) const noexcept {
     return trace_ == other.trace_;
@@ -141,24 +518,377 @@ class pool_allocator {
   }
 
  private:
-  MEMORY_CPP20CONSTEXPR uint8_t* state() noexcept {
-    return reinterpret_cast<uint8_t*>(trace_ + 1);
+  using segment_iterator = typename std::vector<segment>::iterator;
+
+  MEMORY_CPP20CONSTEXPR pool_bitmap bitmap(const segment& seg) const noexcept {
+    return pool_bitmap(seg.storage, seg.size >> trace_->block_shift);
+  }
+
+  // Number of blocks occupied by count objects and their guard
+  MEMORY_CPP20CONSTEXPR size_type blocks(size_type count) const noexcept {
+    return (count*sizeof(T) + Checks::kGuard + block_size() - 1) >> trace_->block_shift;
+  }
+
+  // Block positions of seg aligned to alignment are equal to phase modulo step
+  MEMORY_CPP20CONSTEXPR void stride(const segment& seg, size_type alignment,
+                                    size_type& step, size_type& phase) const noexcept {
+    step = 1;
+    phase = 0;
+    if (alignment > block_size()) {
+      step = alignment >> trace_->block_shift;
+      phase = (alignment - reinterpret_cast<std::uintptr_t>(seg.pool) % alignment) % alignment;
+      phase >>= trace_->block_shift;
+    }
+  }
+
+  // First free run of chunk_size blocks in seg starting at an aligned address,
+  // adds the search work to visited
+  MEMORY_CPP20CONSTEXPR size_type find(segment& seg, size_type chunk_size, size_type alignment,
+                                       size_type& visited) const {
+    size_type step;
+    size_type phase;
+    stride(seg, alignment, step, phase);
+    return Placement::find(seg.placement, bitmap(seg), chunk_size, step, phase, visited);
+  }
+
+  // Fills out[done, n) with blocks of count objects taken from free runs of
+  // seg in address order as far as they last. done counts blocks taken so
+  // far, even if it throws.
+  void carve(segment& seg, T** out, size_type n, size_type count, size_type& done) {
+    size_type chunk_size = blocks(count);
+    size_type step;
+    size_type phase;
+    stride(seg, alignof(T), step, phase);
+    size_type spacing = (chunk_size + step - 1) / step * step;
+    pool_bitmap bits = bitmap(seg);
+    size_type visited = 0;
+    for (size_type pos = bits.find(chunk_size, 0, step, phase, visited);
+         done < n && pos != pool_bitmap::npos;
+         pos = bits.find(chunk_size, pos, step, phase, visited)) {
+      size_type run = bits.run(pos, (n - done - 1)*spacing + chunk_size);
+      size_type fit = (run - chunk_size) / spacing + 1;
+      if (spacing == chunk_size) {
+        claim(seg, pos, fit*chunk_size);
+      }
+      for (size_type i = 0; i < fit; ++i) {
+        T* ptr = (spacing == chunk_size)
+            ? reinterpret_cast<T*>(seg.pool + ((pos + i*spacing) << trace_->block_shift))
+            : claim(seg, pos + i*spacing, chunk_size);
+        out[done++] = ptr;
+        // The search that found the run is charged to its first block
+        count_allocation(ptr, count, visited);
+        visited = 0;
+      }
+      pos += fit*spacing;
+    }
   }
 
-  trace_type* alloc_trace(std::size_t size) {
+  // Frees runs consecutive blocks of chunk_size blocks starting at ptr, each
+  // holding count objects. Null pointers are ignored, so are pointers outside
+  // of the pool if Checks validates them.
+  MEMORY_CPP20CONSTEXPR void release(uint8_t* ptr, size_type chunk_size, size_type runs,
+                                     size_type count) noexcept {
+    if (!ptr) { return; }
+    auto seg = owner(ptr);
+    size_type total = chunk_size*runs;
+    if constexpr (Checks::kBoundsChecks) {
+      if (seg == trace_->segments.end() || ((ptr - seg->pool) & (block_size() - 1)) ||
+          ((ptr - seg->pool) >> trace_->block_shift) + total > bitmap(*seg).size()) {
+        Checks::report("deallocation of a pointer not from this pool");
+        return;
+      }
+    }
+    size_type offs = (ptr - seg->pool) >> trace_->block_shift;
+    if constexpr (Checks::kDoubleFree) {
+      if (!bitmap(*seg).all(offs, total)) {
+        Checks::report("double free");
+        return;
+      }
+    }
+    size_type bytes = chunk_size << trace_->block_shift;
+    for (size_type i = 0; i < runs; ++i) {
+      MEMORY_RECORD_EVENT(alloc_event::kDeallocate, count*sizeof(T),
+                          event_offset(ptr + i*bytes), trace_->source);
+      Checks::released(ptr + i*bytes, count*sizeof(T), bytes);
+    }
+    (void)count;
+    bitmap(*seg).reset(offs, total);
+    Placement::give(seg->placement, offs, total);
+    trace_->allocd -= total << trace_->block_shift;
+    if (trace_->stats) {
+      trace_->stats->deallocations.fetch_add(runs, std::memory_order_relaxed);
+    }
+    if (trace_->options.release_empty && seg->pool != trace_->primary &&
+        bitmap(*seg).none()) {
+      trace_->limit -= seg->size;
+      free_segment(*seg);
+      trace_->segments.erase(seg);
+    }
+  }
+
+  MEMORY_CPP20CONSTEXPR T* claim(segment& seg, size_type first, size_type chunk_size) {
+    Placement::take(seg.placement, bitmap(seg), first, chunk_size);
+    bitmap(seg).set(first, chunk_size);
+    if (!seg.pages.empty() && chunk_size) {
+      size_type unit = trim_unit();
+      size_type last = ((first + chunk_size) << trace_->block_shift) - 1;
+      std::fill(seg.pages.begin() + (first << trace_->block_shift) / unit,
+                seg.pages.begin() + last / unit + 1, 0);
+    }
+    trace_->allocd += chunk_size << trace_->block_shift;
+    return reinterpret_cast<T*>(seg.pool + (first << trace_->block_shift));
+  }
+
+  static size_type bucket(size_type value) noexcept {
+    size_type res = 0;
+    for (; value && res + 1 < pool_stats::kBuckets; value >>= 1) {
+      ++res;
+    }
+    return res;
+  }
+
+  // Offset of ptr from the primary segment modulo 2^64, see alloc_event
+  uint64_t event_offset(const uint8_t* ptr) const noexcept {
+    return reinterpret_cast<std::uintptr_t>(ptr) -
+           reinterpret_cast<std::uintptr_t>(trace_->primary);
+  }
+
+  // Records a successful allocation for stats() and event hooks
+  void count_allocation(T* ptr, size_type count, size_type visited) noexcept {
+    MEMORY_RECORD_EVENT(alloc_event::kAllocate, count*sizeof(T),
+                        event_offset(reinterpret_cast<uint8_t*>(ptr)), trace_->source);
+    Checks::allocated(reinterpret_cast<uint8_t*>(ptr), count*sizeof(T),
+                      blocks(count) << trace_->block_shift);
+    counters* c = trace_->stats.get();
+    if (!c) {
+      return;
+    }
+    c->allocations.fetch_add(1, std::memory_order_relaxed);
+    c->sizes[bucket(count*sizeof(T))].fetch_add(1, std::memory_order_relaxed);
+    c->scans[bucket(visited)].fetch_add(1, std::memory_order_relaxed);
+    if (trace_->allocd > c->high_water.load(std::memory_order_relaxed)) {
+      c->high_water.store(trace_->allocd, std::memory_order_relaxed);
+    }
+  }
+
+  // Segment containing ptr, end() if there is none. Without bounds checks
+  // ptr is trusted to be in the pool.
+  MEMORY_CPP20CONSTEXPR segment_iterator owner(uint8_t* ptr) const noexcept {
+    std::vector<segment>& segs = trace_->segments;
+    if (!Checks::kBoundsChecks && segs.size() == 1) { return segs.begin(); }
+    auto it = std::upper_bound(segs.begin(), segs.end(), ptr,
+        [](uint8_t* p, const segment& seg) { return p < seg.pool; });
+    if (it == segs.begin()) { return segs.end(); }
+    --it;
+    return (ptr < it->pool + it->size) ? it : segs.end();
+  }
+
+  // Chains a segment of at least needed bytes, segments grow geometrically
+  segment& grow(size_type needed) {
+    size_type size = std::max(trace_->next_size, needed);
+    segment& seg = add_segment(size);
+    if (trace_->options.prefault) {
+      trace_->last_warm_up = warm_up(seg, trace_->options.prefault_threads,
+                                     trace_->options.lock_pages);
+    }
+    size = seg.size;
+    size_type factor = trace_->options.growth_factor;
+    trace_->next_size = (size <= std::numeric_limits<size_type>::max() / 4 / factor)
+        ? size*factor : size;
+    return seg;
+  }
+
+  static constexpr size_type pool_alignment(size_type block_size) noexcept {
+    return (block_size > kPoolAlignment) ? block_size : kPoolAlignment;
+  }
+
+  // Offset of the pool from the start of the segment, bitmap lies in between
+  static constexpr size_type pool_offset(size_type blocks, size_type block_size) noexcept {
+    size_type align = pool_alignment(block_size);
+    size_type offs = pool_bitmap::storage_size(blocks);
+    return (offs + align - 1) / align * align;
+  }
+
+  bool mapped() const noexcept {
+    return trace_->options.mapped || trace_->options.huge_pages;
+  }
+
+  size_type trim_unit() const noexcept {
+    return page_storage::granularity(trace_->options.huge_pages);
+  }
+
+  size_type trim(segment& seg) noexcept {
+    size_type unit = trim_unit();
+    size_type unit_blocks = std::max<size_type>(unit >> trace_->block_shift, 1);
+    size_type res = 0;
+    size_type run = 0;
+    for (size_type page = 0; page <= seg.pages.size(); ++page) {
+      bool release = false;
+      if (page < seg.pages.size()) {
+        uint8_t& age = seg.pages[page];
+        if (!bitmap(seg).none((page*unit) >> trace_->block_shift, unit_blocks)) {
+          age = 0;
+        } else if (age != kReleased && ++age >= trace_->options.trim_delay) {
+          age = kReleased;
+          release = true;
+        }
+      }
+      if (release) {
+        ++run;
+      } else if (run) {
+        uint8_t* first = seg.pool + (page - run)*unit;
+        if (page_storage::discard(first, run*unit, trace_->options.lazy_trim)) {
+          res += run*unit;
+        }
+        run = 0;
+      }
+    }
+    return res;
+  }
+
+  // Faults in pages of seg, splitting them between threads. Falls back to
+  // fewer threads if they cannot be started.
+  pool_warm_up warm_up(segment& seg, size_type threads, bool lock) noexcept {
+    auto start = std::chrono::steady_clock::now();
+    size_type page = page_storage::page_size();
+    size_type pages = (seg.size + page - 1) / page;
+    threads = std::max<size_type>(std::min(threads, pages), 1);
+    size_type per_thread = (pages + threads - 1) / threads * page;
+    std::vector<std::thread> workers;
+    uint8_t* first = seg.pool;
+    uint8_t* end = seg.pool + seg.size;
+    try {
+      workers.reserve(threads - 1);
+      for (; workers.size() + 1 < threads && size_type(end - first) > per_thread;
+           first += per_thread) {
+        workers.emplace_back(fault_in, first, per_thread);
+      }
+    } catch (...) {}
+    fault_in(first, end - first);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+    pool_warm_up res;
+    res.bytes = seg.size;
+    if (lock) {
+      res.locked = page_storage::lock(seg.pool, seg.size);
+      trace_->locked |= res.locked;
+    }
+    std::fill(seg.pages.begin(), seg.pages.end(), 0);
+    res.elapsed = std::chrono::steady_clock::now() - start;
+    return res;
+  }
+
+  // Writes back the first byte of every page in [ptr, ptr + size) unless the
+  // system can populate them by itself
+  static void fault_in(uint8_t* ptr, size_type size) noexcept {
+    if (!size || page_storage::populate(ptr, size)) {
+      return;
+    }
+    size_type page = page_storage::page_size();
+    volatile uint8_t* p = ptr;
+    for (size_type offs = 0; offs < size; offs += page) {
+      p[offs] = p[offs];
+    }
+    p[size - 1] = p[size - 1];
+  }
+
+  // Pool memory is left as it comes from the source, so untouched pages of
+  // mapped segments are never faulted in
+  segment& add_segment(std::size_t size) {
+    std::size_t bs = block_size();
+    std::size_t blocks = (size + bs - 1) / bs;
+    segment seg{nullptr, blocks*bs, nullptr, {}, {}};
+    if (mapped()) {
+      seg.pool = static_cast<uint8_t*>(
+          page_storage::map(seg.size, pool_alignment(bs), trace_->options.huge_pages,
+                            trace_->options.prefault));
+      blocks = seg.size / bs;
+      try {
+        seg.pages.assign(seg.size / trim_unit(), 0);
+        std::size_t bitmap_size = pool_bitmap::storage_size(blocks);
+        seg.storage = page_storage::map(bitmap_size, alignof(pool_bitmap::word_type), false);
+      } catch (...) {
+        page_storage::unmap(seg.pool, seg.size, pool_alignment(bs), trace_->options.huge_pages);
+        throw;
+      }
+    } else {
+      std::size_t storage_size = pool_offset(blocks, bs) + blocks*bs;
+      seg.storage = (trace_->options.upstream)
+          ? trace_->options.upstream->allocate(storage_size, pool_alignment(bs))
+          : operator new(storage_size, std::align_val_t(pool_alignment(bs)));
+      seg.pool = static_cast<uint8_t*>(seg.storage) + pool_offset(blocks, bs);
+    }
+    std::vector<segment>& segs = trace_->segments;
+    auto it = std::upper_bound(segs.begin(), segs.end(), seg.pool,
+        [](uint8_t* p, const segment& s) { return p < s.pool; });
+    try {
+      Placement::init(seg.placement, blocks);
+      it = segs.insert(it, std::move(seg));
+    } catch (...) {
+      free_segment(seg);
+      throw;
+    }
+    bitmap(*it).init();
+    trace_->limit += it->size;
+    return *it;
+  }
+
+  void free_segment(const segment& seg) noexcept {
+    std::size_t bs = block_size();
+    if (trace_->locked) {
+      page_storage::unlock(seg.pool, seg.size);
+    }
+    if (mapped()) {
+      std::size_t bitmap_size = pool_bitmap::storage_size(seg.size / bs);
+      std::size_t page = page_storage::page_size();
+      bitmap_size = (bitmap_size + page - 1) / page * page;
+      page_storage::unmap(seg.storage, bitmap_size, alignof(pool_bitmap::word_type), false);
+      page_storage::unmap(seg.pool, seg.size, pool_alignment(bs), trace_->options.huge_pages);
+    } else if (trace_->options.upstream) {
+      std::size_t storage_size = pool_offset(seg.size / bs, bs) + seg.size;
+      trace_->options.upstream->deallocate(seg.storage, storage_size, pool_alignment(bs));
+    } else {
+      operator delete(seg.storage, std::align_val_t(pool_alignment(bs)));
+    }
+  }
+
+  trace_type* alloc_trace(std::size_t size, const pool_options& options) {
     if (!size) throw std::bad_alloc();
-    std::size_t trace_size = sizeof(trace_type) + (size + 7)/8 + size;
-    trace_type* ptr = reinterpret_cast<trace_type*>(operator new(trace_size));
-    std::memset(ptr, 0, trace_size);
-    return ptr;
+    std::size_t block_size = options.block_size;
+    if (!block_size || (block_size & (block_size - 1))) {
+      throw std::invalid_argument("Pool block size must be a power of two");
+    }
+    if (!options.growth_factor) {
+      throw std::invalid_argument("Pool growth factor must be positive");
+    }
+    if (!options.trim_delay || options.trim_delay >= kReleased) {
+      throw std::invalid_argument("Pool trim delay must be between 1 and 254");
+    }
+    if (options.upstream && (options.mapped || options.huge_pages)) {
+      throw std::invalid_argument("Mapped pool cannot take storage from upstream resource");
+    }
+    if (!options.prefault_threads) {
+      throw std::invalid_argument("Pool prefault threads must be positive");
+    }
+    std::size_t shift = 0;
+    for (; (std::size_t(1) << shift) < block_size; ++shift) {}
+    return new trace_type{0, 0, 1, shift, options, 0, nullptr, {}, {}, false, nullptr, 0};
+  }
+
+  void free_trace() noexcept {
+    for (const segment& seg : trace_->segments) {
+      free_segment(seg);
+    }
+    delete trace_;
   }
 
-  uint8_t* pool_;
   trace_type* trace_;
 };
 
-template <typename T>
-void swap(pool_allocator<T>& lhs, pool_allocator<T>& rhs) noexcept {
+template <typename T, typename Placement, typename Checks>
+void swap(pool_allocator<T, Placement, Checks>& lhs,
+          pool_allocator<T, Placement, Checks>& rhs) noexcept {
   lhs.swap(rhs);
 }
 }  // namespace memory
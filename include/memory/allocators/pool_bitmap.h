@@ -0,0 +1,503 @@
+#ifndef MEMORY_ALLOCATORS_POOL_BITMAP_H_
+#define MEMORY_ALLOCATORS_POOL_BITMAP_H_
+#include <cstddef>      // std::size_t
+#include <cstdint>      // uint64_t
+
+#if __has_include(<bit>)
+#include <bit>          // std::countr_zero, std::countl_zero
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>  // _mm256_testz_si256
+#endif
+
+namespace memory {
+// Non-owning view over an occupancy bitmap stored as 64-bit words followed by
+// a summary index. Bit i lives in word i/64 at position i%64, set bit means
+// used. Padding bits past size() are kept set, so scans never need to check
+// bounds inside the last word.
+//
+// Summary index is a segment tree over leaves of kLeafWords words. Every node
+// keeps lengths of its free prefix, free suffix and longest free run, which
+// lets find() descend straight to the first fitting leaf instead of scanning
+// the whole bitmap. set() and reset() refresh touched leaves and their
+// ancestors only.
+class pool_bitmap {
+ public:
+  using word_type = uint64_t;
+  using size_type = std::size_t;
+
+  static constexpr size_type kWordBits = 64;
+  static constexpr size_type kLeafWords = 64;
+  static constexpr size_type kLeafBits = kLeafWords*kWordBits;
+  static constexpr size_type npos = static_cast<size_type>(-1);
+
+  constexpr pool_bitmap() noexcept
+      : words_(nullptr), nodes_(nullptr), size_(0), leaves_(0) {}
+
+  // storage must be at least storage_size(size) bytes aligned to word_type
+  pool_bitmap(void* storage, size_type size) noexcept
+      : words_(static_cast<word_type*>(storage)),
+        nodes_(reinterpret_cast<summary*>(words_ + word_count(size))),
+        size_(size),
+        leaves_(leaf_count(size)) {}
+
+  // Number of words required to hold size bits
+  static constexpr size_type word_count(size_type size) noexcept {
+    return (size + kWordBits - 1) / kWordBits;
+  }
+
+  // Number of bytes required to hold size bits and their summary
+  static constexpr size_type storage_size(size_type size) noexcept {
+    return word_count(size)*sizeof(word_type) +
+           2*leaf_count(size)*sizeof(summary);
+  }
+
+  // Clears every bit, sets the padding bits of the last word and rebuilds
+  // the summary
+  void init() noexcept {
+    size_type count = word_count(size_);
+    for (size_type i = 0; i < count; ++i) {
+      words_[i] = 0;
+    }
+    if (size_ % kWordBits) {
+      words_[count - 1] = ~mask(0, size_ % kWordBits);
+    }
+    for (size_type i = 0; i < leaves_; ++i) {
+      size_type len = length(leaves_ + i);
+      nodes_[leaves_ + i] = summary{len, len, len};
+    }
+    for (size_type i = leaves_ - 1; i; --i) {
+      pull(i);
+    }
+  }
+
+  constexpr size_type size() const noexcept { return size_; }
+  constexpr word_type* data() const noexcept { return words_; }
+
+  bool test(size_type pos) const noexcept {
+    return (words_[pos / kWordBits] >> (pos % kWordBits)) & 1;
+  }
+
+  // True if no bit besides padding is set
+  bool none() const noexcept { return nodes_[1].longest == size_; }
+
+  // Length of the longest run of clear bits
+  size_type longest() const noexcept { return nodes_[1].longest; }
+
+  // Length of the run of clear bits starting at pos, counted no further than
+  // limit bits
+  size_type run(size_type pos, size_type limit = npos) const noexcept {
+    if (pos >= size_) return 0;
+    size_type i = pos / kWordBits;
+    size_type offs = pos % kWordBits;
+    size_type res = countr_zero(words_[i] >> offs);
+    if (res < kWordBits - offs) {
+      return (res < limit) ? res : limit;
+    }
+    res = kWordBits - offs;
+    size_type words = word_count(size_);
+    size_type zero = zero_words(++i, words, limit / kWordBits + 1);
+    res += zero*kWordBits;
+    if (i + zero < words) {
+      res += countr_zero(words_[i + zero]);
+    }
+    return (res < limit) ? res : limit;
+  }
+
+  // Number of maximal runs of clear bits
+  size_type runs() const noexcept {
+    size_type res = 0;
+    word_type carry = 0;
+    for (size_type i = 0; i < word_count(size_); ++i) {
+      word_type free = ~words_[i];
+      res += popcount(free & ~((free << 1) | carry));
+      carry = free >> (kWordBits - 1);
+    }
+    return res;
+  }
+
+  // True if bits [pos, pos + count) are all clear
+  bool none(size_type pos, size_type count) const noexcept {
+    if (pos + count > size_) return false;
+    return for_each_word(pos, count, [](word_type w, word_type m) {
+      return !(w & m);
+    });
+  }
+
+  // True if bits [pos, pos + count) are all set
+  bool all(size_type pos, size_type count) const noexcept {
+    if (pos + count > size_) return false;
+    return for_each_word(pos, count, [](word_type w, word_type m) {
+      return (w & m) == m;
+    });
+  }
+
+  // Sets bits [pos, pos + count)
+  void set(size_type pos, size_type count) noexcept {
+    update(pos, count, [](word_type& w, word_type m) { w |= m; });
+    refresh(pos, count, true);
+  }
+
+  // Clears bits [pos, pos + count)
+  void reset(size_type pos, size_type count) noexcept {
+    update(pos, count, [](word_type& w, word_type m) { w &= ~m; });
+    refresh(pos, count, false);
+  }
+
+  // Returns position of the first run of count clear bits starting at or
+  // after from, npos if there is none. If align is greater than one, only
+  // positions equal to phase modulo align are considered; align must be a
+  // power of two.
+  size_type find(size_type count, size_type from = 0, size_type align = 1,
+                 size_type phase = 0) const noexcept {
+    size_type visited = 0;
+    return find(count, from, align, phase, visited);
+  }
+
+  // Same as above, adds number of summary nodes and words looked at to
+  // visited
+  size_type find(size_type count, size_type from, size_type align, size_type phase,
+                 size_type& visited) const noexcept {
+    request req{count, align - 1, phase};
+    from = req.aligned(from);
+    if (!count || from >= size_) {
+      return (!count && from <= size_) ? from : npos;
+    }
+    if (nodes_[1].longest < count) {
+      return npos;
+    }
+    size_type carry = 0;
+    return search(1, 0, leaves_, req, from, carry, visited);
+  }
+
+  // Word scan of find() without the summary index over any word storage,
+  // such as the atomic words of concurrent_pool_allocator. Returns position
+  // of the first run of count clear bits lying in [from, last), npos if there
+  // is none. View provides word(i), zero_words(first, words, limit) and
+  // full_words(first, words) like pool_bitmap does; bits past last in its
+  // last word are ignored.
+  template <typename View>
+  static size_type scan(const View& view, size_type count, size_type from, size_type last,
+                        size_type align = 1, size_type phase = 0) noexcept {
+    request req{count, align - 1, phase};
+    from = req.aligned(from);
+    if (!count || from >= last) {
+      return (!count && from <= last) ? from : npos;
+    }
+    size_type visited = 0;
+    return scan_words(view, req, from, last, visited);
+  }
+
+  static constexpr word_type mask(size_type first, size_type last) noexcept {
+    return ((last == kWordBits) ? ~word_type(0) : (word_type(1) << last) - 1) &
+           ~((word_type(1) << first) - 1);
+  }
+
+  static size_type countr_zero(word_type w) noexcept {
+#if defined(__cpp_lib_bitops)
+    return std::countr_zero(w);
+#else
+    return w ? __builtin_ctzll(w) : kWordBits;
+#endif
+  }
+
+  static size_type countr_one(word_type w) noexcept {
+    return countr_zero(~w);
+  }
+
+  static size_type popcount(word_type w) noexcept {
+#if defined(__cpp_lib_bitops)
+    return std::popcount(w);
+#else
+    return __builtin_popcountll(w);
+#endif
+  }
+
+  static size_type countl_zero(word_type w) noexcept {
+#if defined(__cpp_lib_bitops)
+    return std::countl_zero(w);
+#else
+    return w ? __builtin_clzll(w) : kWordBits;
+#endif
+  }
+
+ private:
+  struct summary {
+    size_type prefix;
+    size_type suffix;
+    size_type longest;
+  };
+
+  struct request {
+    size_type count;
+    size_type mask;
+    size_type phase;
+
+    // First acceptable position not less than pos
+    constexpr size_type aligned(size_type pos) const noexcept {
+      return pos + ((phase - pos) & mask);
+    }
+
+    // Length a clear run starting at pos must have to fit the request
+    constexpr size_type need(size_type pos) const noexcept {
+      return aligned(pos) - pos + count;
+    }
+  };
+
+  // Leaves are rounded up to a power of two so that the tree is complete
+  static constexpr size_type leaf_count(size_type size) noexcept {
+    size_type leaves = 1;
+    while (leaves*kLeafBits < size) leaves *= 2;
+    return leaves;
+  }
+
+  // Number of real bits covered by node, zero for padding leaves
+  size_type length(size_type node) const noexcept {
+    size_type level = size_type(1) << (kWordBits - 1 - countl_zero(node));
+    size_type span = leaves_ / level;
+    return length(node - level, span);
+  }
+
+  // Number of real bits covered by span leaves starting from leaf
+  size_type length(size_type leaf, size_type span) const noexcept {
+    size_type first = leaf*kLeafBits;
+    if (first >= size_) return 0;
+    size_type last = first + span*kLeafBits;
+    return ((last < size_) ? last : size_) - first;
+  }
+
+  void pull(size_type node) noexcept {
+    const summary& l = nodes_[2*node];
+    const summary& r = nodes_[2*node + 1];
+    size_type llen = length(2*node);
+    size_type rlen = length(2*node + 1);
+    summary& s = nodes_[node];
+    s.prefix = (l.prefix == llen) ? llen + r.prefix : l.prefix;
+    s.suffix = (r.suffix == rlen) ? rlen + l.suffix : r.suffix;
+    s.longest = (l.longest > r.longest) ? l.longest : r.longest;
+    if (l.suffix + r.prefix > s.longest) s.longest = l.suffix + r.prefix;
+  }
+
+  // Recomputes summary of a leaf straight from its words
+  void rebuild(size_type leaf) noexcept {
+    size_type first = leaf*kLeafWords;
+    size_type last = first + kLeafWords;
+    if (last > word_count(size_)) last = word_count(size_);
+    summary s{0, 0, 0};
+    size_type i = first;
+    for (; i < last && !words_[i]; ++i) s.prefix += kWordBits;
+    if (i < last) s.prefix += countr_zero(words_[i]);
+    i = last;
+    for (; i > first && !words_[i - 1]; --i) s.suffix += kWordBits;
+    if (i > first) s.suffix += countl_zero(words_[i - 1]);
+    size_type run = 0;
+    for (i = first; i < last; ++i) {
+      word_type word = words_[i];
+      if (!word) {
+        run += kWordBits;
+      } else {
+        for (size_type bit = 0; bit < kWordBits;) {
+          size_type free = countr_zero(word >> bit);
+          if (free > kWordBits - bit) free = kWordBits - bit;
+          run += free;
+          bit += free;
+          if (run > s.longest) s.longest = run;
+          if (bit < kWordBits) {
+            bit += countr_one(word >> bit);
+            run = 0;
+          }
+        }
+      }
+      if (run > s.longest) s.longest = run;
+    }
+    nodes_[leaves_ + leaf] = s;
+  }
+
+  // Refreshes summary for leaves touched by [pos, pos + count) and their
+  // ancestors. Leaves covered entirely are known to be full or empty.
+  void refresh(size_type pos, size_type count, bool used) noexcept {
+    if (!count) return;
+    size_type first = pos / kLeafBits;
+    size_type last = (pos + count - 1) / kLeafBits;
+    for (size_type leaf = first; leaf <= last; ++leaf) {
+      size_type lo = leaf*kLeafBits;
+      size_type len = length(leaves_ + leaf);
+      if (pos <= lo && lo + len <= pos + count) {
+        size_type free = used ? 0 : len;
+        nodes_[leaves_ + leaf] = summary{free, free, free};
+      } else {
+        rebuild(leaf);
+      }
+    }
+    first += leaves_;
+    last += leaves_;
+    while (first > 1) {
+      first /= 2;
+      last /= 2;
+      for (size_type node = first; node <= last; ++node) {
+        pull(node);
+      }
+    }
+  }
+
+  // Returns the first fitting run inside node starting at or after from.
+  // carry holds length of the clear run that ends right before the node and
+  // starts at or after from; it is updated to the same value for the end of
+  // the node.
+  size_type search(size_type node, size_type lo, size_type hi, const request& req,
+                   size_type from, size_type& carry, size_type& visited) const noexcept {
+    ++visited;
+    size_type first = lo*kLeafBits;
+    size_type len = length(lo, hi - lo);
+    if (!len) {
+      carry = 0;
+      return npos;
+    }
+    if (first + len <= from) {
+      return npos;
+    }
+    const summary& s = nodes_[node];
+    if (first >= from) {
+      if (carry + s.prefix >= req.need(first - carry)) {
+        return req.aligned(first - carry);
+      }
+      if (s.longest < req.count) {
+        carry = (s.prefix == len) ? carry + len : s.suffix;
+        return npos;
+      }
+    }
+    if (hi - lo == 1) {
+      size_type res = scan_words(*this, req, (first > from) ? first - carry : from, first + len,
+                                 visited);
+      if (first >= from) {
+        carry = (s.prefix == len) ? carry + len : s.suffix;
+      } else {
+        carry = (s.suffix < first + len - from) ? s.suffix : first + len - from;
+      }
+      return res;
+    }
+    size_type mid = (lo + hi) / 2;
+    size_type res = search(2*node, lo, mid, req, from, carry, visited);
+    if (res != npos) return res;
+    return search(2*node + 1, mid, hi, req, from, carry, visited);
+  }
+
+  // Linear word scan for a fitting run of clear bits lying in [from, last),
+  // words looked at one by one are added to visited
+  template <typename View>
+  static size_type scan_words(const View& view, const request& req, size_type from,
+                              size_type last, size_type& visited) noexcept {
+    size_type words = word_count(last);
+    size_type run = 0;
+    size_type start = 0;
+    size_type w = from / kWordBits;
+    word_type word = view.word(w) | mask(0, from % kWordBits);
+    while (true) {
+      ++visited;
+      if (w + 1 == words && last % kWordBits) {
+        word |= ~mask(0, last % kWordBits);
+      }
+      if (!word) {
+        if (!run) start = w*kWordBits;
+        size_type limit = (req.need(start) - run - 1) / kWordBits;
+        size_type skip = view.zero_words(w + 1, words - (last % kWordBits != 0), limit);
+        run += (skip + 1)*kWordBits;
+        if (run >= req.need(start)) return req.aligned(start);
+        w += skip;
+      } else if (~word) {
+        for (size_type bit = 0; bit < kWordBits;) {
+          size_type free = countr_zero(word >> bit);
+          if (free > kWordBits - bit) free = kWordBits - bit;
+          if (free) {
+            if (!run) start = w*kWordBits + bit;
+            run += free;
+            if (run >= req.need(start)) return req.aligned(start);
+            bit += free;
+          }
+          if (bit < kWordBits) {
+            bit += countr_one(word >> bit);
+            run = 0;
+          }
+        }
+      } else {
+        run = 0;
+        w += view.full_words(w + 1, words);
+      }
+      if (++w >= words) return npos;
+      word = view.word(w);
+    }
+  }
+
+  word_type word(size_type i) const noexcept { return words_[i]; }
+
+  // Calls op(word, mask) for every word touched by [pos, pos + count)
+  template <typename Op>
+  void update(size_type pos, size_type count, Op op) noexcept {
+    if (!count) return;
+    size_type first = pos / kWordBits;
+    size_type last = (pos + count - 1) / kWordBits;
+    if (first == last) {
+      op(words_[first], mask(pos % kWordBits, (pos + count - 1) % kWordBits + 1));
+      return;
+    }
+    op(words_[first], mask(pos % kWordBits, kWordBits));
+    for (size_type i = first + 1; i < last; ++i) {
+      op(words_[i], ~word_type(0));
+    }
+    op(words_[last], mask(0, (pos + count - 1) % kWordBits + 1));
+  }
+
+  // Returns false as soon as pred(word, mask) fails over [pos, pos + count)
+  template <typename Pred>
+  bool for_each_word(size_type pos, size_type count, Pred pred) const noexcept {
+    if (!count) return true;
+    size_type first = pos / kWordBits;
+    size_type last = (pos + count - 1) / kWordBits;
+    if (first == last) {
+      return pred(words_[first], mask(pos % kWordBits, (pos + count - 1) % kWordBits + 1));
+    }
+    if (!pred(words_[first], mask(pos % kWordBits, kWordBits))) return false;
+    for (size_type i = first + 1; i < last; ++i) {
+      if (!pred(words_[i], ~word_type(0))) return false;
+    }
+    return pred(words_[last], mask(0, (pos + count - 1) % kWordBits + 1));
+  }
+
+  // Number of consecutive zero words starting at first, scanning no further
+  // than first + limit and words
+  size_type zero_words(size_type first, size_type words, size_type limit) const noexcept {
+    size_type last = (first + limit < words) ? first + limit : words;
+    size_type i = first;
+#if defined(__AVX2__)
+    for (; i + 4 <= last; i += 4) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words_ + i));
+      if (!_mm256_testz_si256(v, v)) break;
+    }
+#endif
+    for (; i < last && !words_[i]; ++i) {}
+    return i - first;
+  }
+
+  // Number of consecutive fully used words starting at first
+  size_type full_words(size_type first, size_type words) const noexcept {
+    size_type i = first;
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    for (; i + 4 <= words; i += 4) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words_ + i));
+      if (!_mm256_testc_si256(v, ones)) break;
+    }
+#endif
+    for (; i < words && !~words_[i]; ++i) {}
+    return i - first;
+  }
+
+  word_type* words_;
+  summary* nodes_;
+  size_type size_;
+  size_type leaves_;
+};
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_POOL_BITMAP_H_
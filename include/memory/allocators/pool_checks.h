@@ -0,0 +1,105 @@
+#ifndef MEMORY_ALLOCATORS_POOL_CHECKS_H_
+#define MEMORY_ALLOCATORS_POOL_CHECKS_H_
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace memory {
+// Checking policies of pool_allocator. Every policy provides:
+//
+//   base                      - base class of pool_allocator, the pool is
+//                               polymorphic if base is
+//   kLeakScan                 - destroying the last copy throws
+//                               std::runtime_error if blocks are in use
+//   kBoundsChecks             - deallocation of pointers outside of the pool
+//                               or off block boundaries is ignored
+//   kDoubleFree               - deallocation of blocks not in use is ignored
+//   kGuard                    - bytes reserved after every allocation
+//   report(what)              - misuse caught by the checks above
+//   allocated(ptr, size, room)
+//                             - size bytes at ptr were handed out, room
+//                               bytes up to the end of its blocks are owned
+//   released(ptr, size, room) - same block is about to be freed
+//   resized(ptr, size, room)  - same block is about to change its size
+//
+// Hooks are noexcept and see every block separately, also in batches.
+
+// Checks pool_allocator has always done
+struct default_checks {
+  struct base {
+    virtual ~base() noexcept(false) = default;
+  };
+
+  static constexpr bool kLeakScan = true;
+  static constexpr bool kBoundsChecks = true;
+  static constexpr bool kDoubleFree = false;
+  static constexpr std::size_t kGuard = 0;
+
+  static void report(const char*) noexcept {}
+  static void allocated(uint8_t*, std::size_t, std::size_t) noexcept {}
+  static void released(uint8_t*, std::size_t, std::size_t) noexcept {}
+  static void resized(uint8_t*, std::size_t, std::size_t) noexcept {}
+};
+
+// No checks at all. The pool is a single pointer without a vtable and
+// deallocation trusts its arguments.
+struct release_checks {
+  struct base {};
+
+  static constexpr bool kLeakScan = false;
+  static constexpr bool kBoundsChecks = false;
+  static constexpr bool kDoubleFree = false;
+  static constexpr std::size_t kGuard = 0;
+
+  static void report(const char*) noexcept {}
+  static void allocated(uint8_t*, std::size_t, std::size_t) noexcept {}
+  static void released(uint8_t*, std::size_t, std::size_t) noexcept {}
+  static void resized(uint8_t*, std::size_t, std::size_t) noexcept {}
+};
+
+// Everything default_checks does plus double free detection, fill patterns
+// and guard canaries after every allocation. Misuse aborts the program with
+// a message on stderr.
+struct debug_checks {
+  struct base {
+    virtual ~base() noexcept(false) = default;
+  };
+
+  static constexpr bool kLeakScan = true;
+  static constexpr bool kBoundsChecks = true;
+  static constexpr bool kDoubleFree = true;
+  static constexpr std::size_t kGuard = 8;
+
+  // Fill of fresh memory, freed memory and guards
+  static constexpr uint8_t kAllocated = 0xcd;
+  static constexpr uint8_t kReleased = 0xdd;
+  static constexpr uint8_t kCanary = 0xfd;
+
+  [[noreturn]] static void report(const char* what) noexcept {
+    std::fprintf(stderr, "pool_allocator: %s\n", what);
+    std::abort();
+  }
+
+  static void allocated(uint8_t* ptr, std::size_t size, std::size_t room) noexcept {
+    std::memset(ptr, kAllocated, size);
+    std::memset(ptr + size, kCanary, room - size);
+  }
+
+  static void released(uint8_t* ptr, std::size_t size, std::size_t room) noexcept {
+    resized(ptr, size, room);
+    std::memset(ptr, kReleased, room);
+  }
+
+  static void resized(uint8_t* ptr, std::size_t size, std::size_t room) noexcept {
+    for (std::size_t i = size; i < room; ++i) {
+      if (ptr[i] != kCanary) {
+        report("guard canary overwritten");
+      }
+    }
+  }
+};
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_POOL_CHECKS_H_
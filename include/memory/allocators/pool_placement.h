@@ -0,0 +1,217 @@
+#ifndef MEMORY_ALLOCATORS_POOL_PLACEMENT_H_
+#define MEMORY_ALLOCATORS_POOL_PLACEMENT_H_
+#include <cstddef>
+#include <iterator>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+
+#include "pool_bitmap.h"
+
+namespace memory {
+// Placement policies of pool_allocator. Every policy keeps its own state for
+// each pool segment next to the segment bitmap and provides:
+//
+//   init(state, size)                    - segment of size blocks is empty
+//   find(state, bitmap, count, step, phase, visited)
+//                                        - position of a free run of count
+//                                          blocks equal to phase modulo step,
+//                                          pool_bitmap::npos if there is none;
+//                                          adds the number of bitmap nodes,
+//                                          words or index entries it looked
+//                                          at to visited
+//   take(state, bitmap, pos, count)      - blocks are about to be marked
+//                                          used, may throw
+//   give(state, pos, count)              - blocks were marked free
+//
+// Policy state must stay unchanged if take() throws.
+
+// Lowest fitting position. Cheapest to maintain, but small blocks pile up at
+// the front of the pool and every search has to skip past them.
+struct first_fit {
+  struct state {};
+
+  static void init(state&, std::size_t) noexcept {}
+
+  static std::size_t find(state&, const pool_bitmap& bitmap, std::size_t count,
+                          std::size_t step, std::size_t phase,
+                          std::size_t& visited) noexcept {
+    return bitmap.find(count, 0, step, phase, visited);
+  }
+
+  static void take(state&, const pool_bitmap&, std::size_t, std::size_t) noexcept {}
+  static void give(state&, std::size_t, std::size_t) noexcept {}
+};
+
+// First fitting position after the end of the previous allocation, wraps to
+// the start of the segment once the cursor runs off its end
+struct next_fit {
+  struct state {
+    std::size_t cursor;
+  };
+
+  static void init(state& s, std::size_t) noexcept {
+    s.cursor = 0;
+  }
+
+  static std::size_t find(state& s, const pool_bitmap& bitmap, std::size_t count,
+                          std::size_t step, std::size_t phase,
+                          std::size_t& visited) noexcept {
+    std::size_t res = bitmap.find(count, s.cursor, step, phase, visited);
+    if (res == pool_bitmap::npos && s.cursor) {
+      res = bitmap.find(count, 0, step, phase, visited);
+    }
+    return res;
+  }
+
+  static void take(state& s, const pool_bitmap&, std::size_t pos,
+                   std::size_t count) noexcept {
+    s.cursor = pos + count;
+  }
+
+  static void give(state&, std::size_t, std::size_t) noexcept {}
+};
+
+// Smallest free extent the request fits in, ties go to the lowest address.
+// Free extents are indexed by position and by length, so the search is
+// O(log extents) unless alignment rules out the smallest candidates. Index
+// nodes are allocated from Allocator, the global heap for best_fit. If that
+// fails while memory is being freed, the index is rebuilt from the bitmap by
+// the next search.
+template <typename Allocator = std::allocator<std::size_t>>
+struct basic_best_fit {
+  using extent = std::pair<std::size_t, std::size_t>;
+
+  struct state {
+    std::map<std::size_t, std::size_t, std::less<std::size_t>,
+             typename std::allocator_traits<Allocator>::template rebind_alloc<
+                 std::pair<const std::size_t, std::size_t>>> by_pos;
+    std::set<extent, std::less<extent>,
+             typename std::allocator_traits<Allocator>::template rebind_alloc<extent>> by_size;
+    bool stale;
+  };
+
+  static void init(state& s, std::size_t size) {
+    s.by_pos.clear();
+    s.by_size.clear();
+    s.stale = false;
+    insert(s, 0, size);
+  }
+
+  static std::size_t find(state& s, const pool_bitmap& bitmap, std::size_t count,
+                          std::size_t step, std::size_t phase, std::size_t& visited) {
+    if (s.stale) {
+      rebuild(s, bitmap);
+    }
+    if (!count) {
+      return bitmap.find(count, 0, step, phase, visited);
+    }
+    for (auto it = s.by_size.lower_bound({count, 0}); it != s.by_size.end(); ++it) {
+      ++visited;
+      std::size_t first = it->second + ((phase - it->second) & (step - 1));
+      if (first + count <= it->second + it->first) {
+        return first;
+      }
+    }
+    return pool_bitmap::npos;
+  }
+
+  // Splits the extent containing [pos, pos + count), leaves the index intact
+  // if it throws. Callers may take a run without a find() first, so a stale
+  // index is rebuilt here as well.
+  static void take(state& s, const pool_bitmap& bitmap, std::size_t pos,
+                   std::size_t count) {
+    if (!count) return;
+    if (s.stale) {
+      rebuild(s, bitmap);
+    }
+    auto it = std::prev(s.by_pos.upper_bound(pos));
+    std::size_t first = it->first;
+    std::size_t last = first + it->second;
+    if (pos + count < last) {
+      insert(s, pos + count, last - pos - count);
+    }
+    if (first < pos) {
+      resize(s, it, pos - first);
+    } else {
+      erase(s, it);
+    }
+  }
+
+  // Merges [pos, pos + count) with adjacent free extents
+  static void give(state& s, std::size_t pos, std::size_t count) noexcept {
+    if (!count || s.stale) return;
+    auto next = s.by_pos.lower_bound(pos);
+    auto prev = (next != s.by_pos.begin()) ? std::prev(next) : s.by_pos.end();
+    bool merge_prev = prev != s.by_pos.end() && prev->first + prev->second == pos;
+    bool merge_next = next != s.by_pos.end() && next->first == pos + count;
+    if (merge_prev) {
+      std::size_t length = prev->second + count;
+      if (merge_next) {
+        length += next->second;
+        erase(s, next);
+      }
+      resize(s, prev, length);
+    } else if (merge_next) {
+      auto size_node = s.by_size.extract({next->second, next->first});
+      size_node.value() = {next->second + count, pos};
+      auto pos_node = s.by_pos.extract(next);
+      pos_node.key() = pos;
+      pos_node.mapped() += count;
+      s.by_size.insert(std::move(size_node));
+      s.by_pos.insert(std::move(pos_node));
+    } else {
+      try {
+        insert(s, pos, count);
+      } catch (...) {
+        s.stale = true;
+      }
+    }
+  }
+
+ private:
+  using extent_iterator = typename decltype(state::by_pos)::iterator;
+
+  // Strong guarantee
+  static void insert(state& s, std::size_t pos, std::size_t count) {
+    auto it = s.by_pos.emplace(pos, count).first;
+    try {
+      s.by_size.emplace(count, pos);
+    } catch (...) {
+      s.by_pos.erase(it);
+      throw;
+    }
+  }
+
+  static void erase(state& s, extent_iterator it) noexcept {
+    s.by_size.erase({it->second, it->first});
+    s.by_pos.erase(it);
+  }
+
+  // Changes length of an extent, reuses index nodes
+  static void resize(state& s, extent_iterator it, std::size_t count) noexcept {
+    auto node = s.by_size.extract({it->second, it->first});
+    node.value() = {count, it->first};
+    s.by_size.insert(std::move(node));
+    it->second = count;
+  }
+
+  static void rebuild(state& s, const pool_bitmap& bitmap) {
+    s.by_pos.clear();
+    s.by_size.clear();
+    for (std::size_t pos = bitmap.find(1); pos != pool_bitmap::npos;) {
+      std::size_t last = pos + 1;
+      for (; last < bitmap.size() && !bitmap.test(last); ++last) {}
+      insert(s, pos, last - pos);
+      pos = bitmap.find(1, last);
+    }
+    s.stale = false;
+  }
+};
+
+using best_fit = basic_best_fit<>;
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_POOL_PLACEMENT_H_
@@ -0,0 +1,281 @@
+#ifndef MEMORY_ALLOCATORS_SLAB_ALLOCATOR_H_
+#define MEMORY_ALLOCATORS_SLAB_ALLOCATOR_H_
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "allocation_result.h"
+#include "pool_allocator.h"
+
+namespace memory {
+// Shared part of slab_allocator, not meant to be used directly.
+//
+// Single objects of up to kMaxObject bytes are grouped in size classes of
+// kGranularity bytes, arrays always go to the pool, so growing containers do
+// not leave slabs behind in every class they pass through. Every class carves kSlabBytes slabs out of the pool and
+// keeps freed objects in an intrusive singly linked list, so allocation and
+// deallocation of a single object are O(1). Fresh slabs are handed out with a
+// bump pointer, so they are not touched before use. Slabs stay with their
+// class until the pool is destroyed.
+class slab_state {
+ public:
+  using size_type = std::size_t;
+
+  static constexpr size_type kGranularity = 16;
+  static constexpr size_type kClasses = 16;
+  static constexpr size_type kMaxObject = kGranularity*kClasses;
+  static constexpr size_type kSlabBytes = 4096;
+
+  slab_state(size_type size, size_type block_size)
+      : ref_count(1), pool_(size, block_size), classes_(), live_(0) {}
+
+  slab_state(const slab_state&) = delete;
+  slab_state& operator=(const slab_state&) = delete;
+
+  ~slab_state() noexcept(false) {
+    for (auto& slab : slabs_) {
+      pool_.deallocate(slab.first, slab.second);
+    }
+    // Leaked runs are reported by the pool itself
+    if (live_ && !pool_.allocd()) {
+      throw std::runtime_error("Memory leak detected: attempting to destroy slab allocator that has memory being used and not dealloc'd'");
+    }
+  }
+
+  // True if request is served from slabs
+  static constexpr bool slabbed(size_type count, size_type size, size_type alignment) noexcept {
+    return count == 1 && size && size <= kMaxObject && alignment <= kGranularity;
+  }
+
+  void* allocate(size_type count, size_type size, size_type alignment) {
+    if (!slabbed(count, size, alignment)) {
+      return pool_.allocate(count*size, alignment);
+    }
+    size_type bytes = count*size;
+    size_class& cls = classes_[(bytes - 1) / kGranularity];
+    void* res;
+    if (cls.free) {
+      res = cls.free;
+      cls.free = cls.free->next;
+    } else {
+      if (cls.cursor == cls.end) {
+        grow(cls, class_size(bytes));
+      }
+      res = cls.cursor;
+      cls.cursor += class_size(bytes);
+    }
+    ++live_;
+    return res;
+  }
+
+  void deallocate(void* ptr, size_type count, size_type size, size_type alignment) noexcept {
+    if (!slabbed(count, size, alignment)) {
+      pool_.deallocate(static_cast<uint8_t*>(ptr), count*size);
+      return;
+    }
+    size_class& cls = classes_[(count*size - 1) / kGranularity];
+    node* n = static_cast<node*>(ptr);
+    n->next = cls.free;
+    cls.free = n;
+    --live_;
+  }
+
+  // Number of objects of size bytes that fit into the memory handed out for
+  // count of them, deallocating with that number frees the same memory
+  size_type capacity(size_type count, size_type size, size_type alignment) const noexcept {
+    if (!size) {
+      return count;
+    }
+    size_type bytes = count*size;
+    if (slabbed(count, size, alignment)) {
+      bytes = class_size(bytes);
+    } else {
+      bytes = (bytes + pool_.block_size() - 1) / pool_.block_size() * pool_.block_size();
+    }
+    return std::max(count, bytes / size);
+  }
+
+  size_type max_size() const noexcept { return pool_.max_size(); }
+  size_type allocd() const noexcept { return pool_.allocd(); }
+  size_type remaining() const noexcept { return pool_.remaining(); }
+
+  size_type ref_count;
+
+ private:
+  struct node {
+    node* next;
+  };
+
+  struct size_class {
+    node* free;
+    uint8_t* cursor;
+    uint8_t* end;
+  };
+
+  static constexpr size_type class_size(size_type size) noexcept {
+    return (size + kGranularity - 1) / kGranularity * kGranularity;
+  }
+
+  // Takes a new slab from the pool, a single object if the pool cannot fit
+  // a whole slab anymore
+  void grow(size_class& cls, size_type object) {
+    size_type bytes = kSlabBytes / object * object;
+    uint8_t* slab;
+    try {
+      slab = pool_.allocate(bytes, kGranularity);
+    } catch (std::bad_alloc&) {
+      bytes = object;
+      slab = pool_.allocate(bytes, kGranularity);
+    }
+    try {
+      slabs_.emplace_back(slab, bytes);
+    } catch (...) {
+      pool_.deallocate(slab, bytes);
+      throw;
+    }
+    cls.cursor = slab;
+    cls.end = slab + bytes;
+  }
+
+  pool_allocator<uint8_t> pool_;
+  size_class classes_[kClasses];
+  std::vector<std::pair<uint8_t*, size_type>> slabs_;
+  size_type live_;
+};
+
+// No general requirements on type T
+//
+// Pool allocator that serves single small objects from size class slabs with
+// O(1) free lists and falls back to pool_allocator run search for arrays,
+// large or over-aligned objects. Copies share the pool and the slabs.
+// allocd() and remaining() account for whole slabs as allocated.
+template <typename T>
+class slab_allocator {
+  template <typename U>
+  friend class slab_allocator;
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::true_type;
+
+  // block_size is granularity of the underlying pool, must be a power of two
+  explicit slab_allocator(size_type size, size_type block_size = slab_state::kGranularity)
+      : state_(new slab_state(size, block_size)) {}
+
+  template <typename U>
+  slab_allocator(const slab_allocator<U>& other) noexcept : state_(other.state_) {
+    ++state_->ref_count;
+  }
+
+  template <typename U>
+  slab_allocator(slab_allocator<U>&& other) noexcept : slab_allocator(other) {}
+
+  slab_allocator(const slab_allocator& other) noexcept : state_(other.state_) {
+    ++state_->ref_count;
+  }
+
+  slab_allocator(slab_allocator&& other) noexcept : slab_allocator(other) {}
+
+  template <typename U>
+  slab_allocator& operator=(const slab_allocator<U>& other) = delete;
+
+  template <typename U>
+  slab_allocator& operator=(slab_allocator<U>&&) = delete;
+
+  slab_allocator& operator=(const slab_allocator& other) = delete;
+
+  slab_allocator& operator=(slab_allocator&&) = delete;
+
+  virtual ~slab_allocator() noexcept(false) {
+    if (!--state_->ref_count) {
+      delete state_;
+    }
+  }
+
+  //==============================================================================
+
+  size_type max_size() const noexcept {
+    return state_->max_size() / sizeof(T);
+  }
+
+  size_type allocd() const noexcept {
+    return state_->allocd();
+  }
+
+  size_type remaining() const noexcept {
+    return state_->remaining();
+  }
+  //==============================================================================
+
+  void swap(slab_allocator& other) noexcept {
+    std::swap(state_, other.state_);
+  }
+
+  T* allocate(size_type count) {
+    return allocate(count, alignof(T));
+  }
+
+  // alignment must be a power of two, the same alignment must be passed to
+  // deallocate
+  T* allocate(size_type count, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    return static_cast<T*>(state_->allocate(count, sizeof(T), alignment));
+  }
+
+  // Same as allocate(count), count of the result fills the size class or
+  // the pool blocks
+  allocation_result<T*> allocate_at_least(size_type count) {
+    T* ptr = allocate(count);
+    return {ptr, state_->capacity(count, sizeof(T), alignof(T))};
+  }
+
+  void deallocate(T* ptr, size_type count) noexcept {
+    deallocate(ptr, count, alignof(T));
+  }
+
+  void deallocate(T* ptr, size_type count, size_type alignment) noexcept {
+    state_->deallocate(ptr, count, sizeof(T), alignment);
+  }
+
+  // Single object of bytes bytes for callers that do not know its type, such
+  // as allocator_resource. Served from slabs like allocate(1) of that size.
+  void* allocate_bytes(size_type bytes, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    return state_->allocate(1, bytes, alignment);
+  }
+
+  void deallocate_bytes(void* ptr, size_type bytes, size_type alignment) noexcept {
+    state_->deallocate(ptr, 1, bytes, alignment);
+  }
+
+  bool operator==(const slab_allocator& other) const noexcept {
+    return state_ == other.state_;
+  }
+
+  bool operator!=(const slab_allocator& other) const noexcept {
+    return state_ != other.state_;
+  }
+
+ private:
+  slab_state* state_;
+};
+
+template <typename T>
+void swap(slab_allocator<T>& lhs, slab_allocator<T>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_SLAB_ALLOCATOR_H_
@@ -0,0 +1,217 @@
+#ifndef MEMORY_ALLOCATORS_STACK_ALLOCATOR_H_
+#define MEMORY_ALLOCATORS_STACK_ALLOCATOR_H_
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+namespace memory {
+template <typename T>
+class stack_allocator;
+
+// Height of a stack_allocator at the time of mark(), shared by rebound copies
+class stack_marker {
+ public:
+  stack_marker() noexcept : top_(0) {}
+
+ private:
+  template <typename T>
+  friend class stack_allocator;
+
+  explicit stack_marker(std::size_t top) noexcept : top_(top) {}
+
+  std::size_t top_;
+};
+
+// No general requirements on type T
+//
+// LIFO allocator over a fixed buffer. allocate() bumps the top of the stack,
+// deallocate() pops it only if ptr is the topmost allocation, anything else
+// is reclaimed by rewind(). mark() remembers the current top, rewind() drops
+// everything allocated after the mark at once; scope does both in RAII
+// fashion. Memory above a rewound mark must not be used anymore.
+//
+// allocd() is the height of the stack, including alignment padding and
+// blocks freed out of order.
+template <typename T>
+class stack_allocator {
+  template <typename U>
+  friend class stack_allocator;
+
+  struct trace_type {
+    std::size_t top;
+    std::size_t limit;
+    std::size_t ref_count;
+  };
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::true_type;
+
+  static constexpr size_type kPoolAlignment = 64;
+
+  using marker = stack_marker;
+
+  // Rewinds the stack to its height at construction when leaving the scope
+  class scope {
+   public:
+    explicit scope(const stack_allocator& alloc) : alloc_(alloc), mark_(alloc_.mark()) {}
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+    ~scope() {
+      alloc_.rewind(mark_);
+    }
+
+   private:
+    stack_allocator alloc_;
+    marker mark_;
+  };
+
+  explicit stack_allocator(size_type size) : trace_(alloc_trace(size)) {
+    trace_->top = 0;
+    trace_->limit = size;
+    trace_->ref_count = 1;
+  }
+
+  template <typename U>
+  stack_allocator(const stack_allocator<U>& other) noexcept
+      : trace_(reinterpret_cast<trace_type*>(other.trace_)) {
+    ++trace_->ref_count;
+  }
+
+  template <typename U>
+  stack_allocator(stack_allocator<U>&& other) noexcept : stack_allocator(other) {}
+
+  stack_allocator(const stack_allocator& other) noexcept : trace_(other.trace_) {
+    ++trace_->ref_count;
+  }
+
+  stack_allocator(stack_allocator&& other) noexcept : stack_allocator(other) {}
+
+  template <typename U>
+  stack_allocator& operator=(const stack_allocator<U>& other) = delete;
+
+  template <typename U>
+  stack_allocator& operator=(stack_allocator<U>&&) = delete;
+
+  stack_allocator& operator=(const stack_allocator& other) = delete;
+
+  stack_allocator& operator=(stack_allocator&&) = delete;
+
+  virtual ~stack_allocator() {
+    if (!--trace_->ref_count) {
+      operator delete(trace_, std::align_val_t(kPoolAlignment));
+    }
+  }
+
+  //==============================================================================
+
+  size_type max_size() const noexcept {
+    return trace_->limit / sizeof(T);
+  }
+
+  size_type allocd() const noexcept {
+    return trace_->top;
+  }
+
+  size_type remaining() const noexcept {
+    return trace_->limit - trace_->top;
+  }
+
+  marker mark() const noexcept {
+    return marker(trace_->top);
+  }
+
+  // Frees everything allocated after m, marks above the current top are
+  // ignored
+  void rewind(marker m) noexcept {
+    if (m.top_ <= trace_->top) {
+      trace_->top = m.top_;
+    }
+  }
+  //==============================================================================
+
+  void swap(stack_allocator& other) noexcept {
+    std::swap(trace_, other.trace_);
+  }
+
+  T* allocate(size_type count) {
+    return allocate(count, alignof(T));
+  }
+
+  // alignment must be a power of two
+  T* allocate(size_type count, size_type alignment) {
+    if (!alignment || (alignment & (alignment - 1))) {
+      throw std::invalid_argument("Alignment must be a power of two");
+    }
+    std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(pool() + trace_->top);
+    size_type first = trace_->top + (alignment - addr % alignment) % alignment;
+    if (count > max_size() || first > trace_->limit ||
+        count*sizeof(T) > trace_->limit - first) {
+      throw std::bad_alloc();
+    }
+    trace_->top = first + count*sizeof(T);
+    return reinterpret_cast<T*>(pool() + first);
+  }
+
+  // Pops ptr if it is the topmost allocation
+  void deallocate(T* ptr, size_type count) noexcept {
+    uint8_t* p = reinterpret_cast<uint8_t*>(ptr);
+    if (p + count*sizeof(T) == pool() + trace_->top && p >= pool()) {
+      trace_->top = p - pool();
+    }
+  }
+
+  // Grows ptr from old_count to new_count objects if it is the topmost
+  // allocation and the stack has room, returns false otherwise
+  bool try_expand(T* ptr, size_type old_count, size_type new_count) noexcept {
+    uint8_t* p = reinterpret_cast<uint8_t*>(ptr);
+    if (p + old_count*sizeof(T) != pool() + trace_->top || p < pool() ||
+        new_count < old_count || new_count > max_size() ||
+        new_count*sizeof(T) > trace_->limit - (p - pool())) {
+      return false;
+    }
+    trace_->top = (p - pool()) + new_count*sizeof(T);
+    return true;
+  }
+
+  bool operator==(const stack_allocator& other) const noexcept {
+    return trace_ == other.trace_;
+  }
+
+  bool operator!=(const stack_allocator& other) const noexcept {
+    return trace_ != other.trace_;
+  }
+
+ private:
+  static constexpr size_type pool_offset() noexcept {
+    return (sizeof(trace_type) + kPoolAlignment - 1) / kPoolAlignment * kPoolAlignment;
+  }
+
+  uint8_t* pool() const noexcept {
+    return reinterpret_cast<uint8_t*>(trace_) + pool_offset();
+  }
+
+  trace_type* alloc_trace(size_type size) {
+    if (!size) throw std::bad_alloc();
+    return reinterpret_cast<trace_type*>(
+        operator new(pool_offset() + size, std::align_val_t(kPoolAlignment)));
+  }
+
+  trace_type* trace_;
+};
+
+template <typename T>
+void swap(stack_allocator<T>& lhs, stack_allocator<T>& rhs) noexcept {
+  lhs.swap(rhs);
+}
+}  // namespace memory
+
+#endif  // MEMORY_ALLOCATORS_STACK_ALLOCATOR_H_
@@ -4,6 +4,13 @@
 #include "../iterators/pointer_iterator.h"  // iterator and std::distance
 #include "../iterators/reverse_iterator.h"
 
+#if defined(MEMORY_ALLOC_EVENTS)
+#include "../allocators/event_recorder.h"   // MEMORY_RECORD_EVENT
+#elif !defined(MEMORY_RECORD_EVENT)
+#define MEMORY_RECORD_EVENT(...) ((void)0)
+#endif
+
+#include <algorithm>    // std::rotate
 #include <cstdint>      // types
 #include <ostream>      // operator<<
 #include <stdexcept>    // exceptions
@@ -277,8 +284,9 @@ class vector {
     }
     pointer p = ptr_;
     if (cap_ < count) {
-      p = create_buffer(count, count, 0, value);
-      swap_out_buffer(p, count);
+      size_type cap = count;
+      p = create_buffer(cap, count, 0, value);
+      swap_out_buffer(p, cap);
     } else {
       pointer end = ptr_ + size_;
       size_type i = count;
@@ -315,7 +323,7 @@ class vector {
   MEMORY_CPP20CONSTEXPR void reserve(size_type count) {
     if (count > max_size()) {
       throw std::length_error("Cannot reserve space more than max_size()");
-    } else if (count > cap_) {
+    } else if (count > cap_ && !expand(count)) {
       pointer p = create_buffer(count);
       swap_out_buffer(p, count);
     }
@@ -324,8 +332,9 @@ class vector {
   // T must meet additional requirements of MoveInsertable into *this
   MEMORY_CPP20CONSTEXPR void shrink_to_fit() {
     if (cap_ > size_) {
-      pointer p = create_buffer(size_);
-      swap_out_buffer(p, size_);
+      size_type cap = size_;
+      pointer p = create_buffer(cap);
+      swap_out_buffer(p, cap);
     }
   }
 
@@ -343,16 +352,17 @@ class vector {
     }
     if (count == size_) {
       return;
-    } else if (count > cap_) {
-      pointer p = create_buffer(count);
+    } else if (count > cap_ && !expand(count)) {
+      size_type cap = count;
+      pointer p = create_buffer(cap);
       try {
         construct(p + size_, count - size_);
       } catch(...) {
         destroy(p, size_);
-        dealloc(p, count);
+        dealloc(p, cap);
         throw;
       }
-      swap_out_buffer(p, count);
+      swap_out_buffer(p, cap);
     } else if (count > size_){
       construct(ptr_ + size_, count - size_);
     } else {
@@ -368,16 +378,17 @@ class vector {
     }
     if (count == size_) {
       return;
-    } else if (count > cap_) {
-      pointer p = create_buffer(count);
+    } else if (count > cap_ && !expand(count)) {
+      size_type cap = count;
+      pointer p = create_buffer(cap);
       try {
         construct(p + size_, count - size_, value);
       } catch(...) {
         destroy(p, size_);
-        dealloc(p, count);
+        dealloc(p, cap);
         throw;
       }
-      swap_out_buffer(p, count);
+      swap_out_buffer(p, cap);
     } else if (count > size_){
       construct(ptr_ + size_, count - size_, value);
     } else {
@@ -525,7 +536,8 @@ class vector {
   MEMORY_CPP20CONSTEXPR iterator emplace(const_iterator pos, Args&&... args) {
     size_type ind = pos - begin();
     if (size_ >= cap_ || !std::is_nothrow_move_constructible<T>::value || !std::is_nothrow_move_assignable<T>::value) {
-      pointer p = create_buffer(cap_*kCapMul + 1, 1, ind, std::forward<Args>(args)...);
+      size_type nsize = cap_*kCapMul + 1;
+      pointer p = create_buffer(nsize, 1, ind, std::forward<Args>(args)...);
       size_type copied = 0;
       try {
         safe_move(p, ptr_, ptr_ + ind);
@@ -534,10 +546,10 @@ class vector {
       } catch (...) {
         destroy(p + ind, 1);
         destroy(p, copied);
-        dealloc(p, cap_*kCapMul + 1);
+        dealloc(p, nsize);
         throw;
       }
-      swap_out_buffer(p, cap_*kCapMul + 1);
+      swap_out_buffer(p, nsize);
    } else if constexpr (std::is_nothrow_move_constructible<T>::value && std::is_nothrow_move_assignable<T>::value){
       T val(std::forward<Args>(args)...);
       std::allocator_traits<Allocator>::construct(al_, ptr_ + size_, std::move(ptr_[size_ - 1]));
@@ -553,16 +565,17 @@ class vector {
   // T is EmplaceConstrutible from args and MoveInsertable into *this
   template <typename... Args>
   MEMORY_CPP20CONSTEXPR T& emplace_back(Args&&... args) {
-    if (size_ >= cap_) {
-      pointer p = create_buffer(cap_*kCapMul + 1, 1, size_, std::forward<Args>(args)...);
+    if (size_ >= cap_ && !expand(cap_*kCapMul + 1)) {
+      size_type nsize = cap_*kCapMul + 1;
+      pointer p = create_buffer(nsize, 1, size_, std::forward<Args>(args)...);
       try {
         safe_move(p, ptr_, ptr_ + size_);
       } catch (...) {
         destroy(p + size_, 1);
-        dealloc(p, cap_*kCapMul + 1);
+        dealloc(p, nsize);
         throw;
       }
-      swap_out_buffer(p, cap_*kCapMul + 1);
+      swap_out_buffer(p, nsize);
     } else {
       std::allocator_traits<Allocator>::construct(al_, ptr_ + size_, std::forward<Args>(args)...);
     }
@@ -626,6 +639,19 @@ class vector {
       nullptr;
   }
 
+  // Same as alloc(count), but takes any extra room the allocator gives
+  // through allocate_at_least() and sets count to it
+  MEMORY_CPP20CONSTEXPR pointer alloc_at_least(size_type& count) {
+    if constexpr (has_allocate_at_least<Allocator>::value) {
+      if (count) {
+        auto res = al_.allocate_at_least(count);
+        count = res.count;
+        return res.ptr;
+      }
+    }
+    return alloc(count);
+  }
+
   // No additional requirements on template types
   MEMORY_CPP20CONSTEXPR void dealloc(pointer p,  size_type count) {
     std::allocator_traits<Allocator>::deallocate(al_, p,  count);
@@ -701,8 +727,9 @@ class vector {
   MEMORY_CPP20CONSTEXPR void copy_assign(size_type count, FwdIt first, FwdIt last) {
     pointer p = ptr_;
     if (cap_ < count) {
-      p = create_buffer(count, 0, first, last);
-      swap_out_buffer(p, count);
+      size_type cap = count;
+      p = create_buffer(cap, 0, first, last);
+      swap_out_buffer(p, cap);
     } else {
       pointer end = ptr_ + size_;
       for (; p != end && first != last; ++first, ++p) {
@@ -721,8 +748,9 @@ class vector {
   MEMORY_CPP20CONSTEXPR void move_assign(size_type count, FwdIt first, FwdIt last) {
     pointer p = ptr_;
     if (cap_ < count) {
-      p = create_buffer(count, 0, first, last);
-      swap_out_buffer(p, count);
+      size_type cap = count;
+      p = create_buffer(cap, 0, first, last);
+      swap_out_buffer(p, cap);
     } else {
       pointer end = ptr_ + size_;
       for (; p != end && first != last; ++first, ++p) {
@@ -737,9 +765,12 @@ class vector {
     size_ = count;
   } 
 
+  // create_buffer overloads allocate at least size objects and set size to
+  // the capacity of the buffer
+
   // T is MoveInsertable
-  MEMORY_CPP20CONSTEXPR pointer create_buffer(size_type size) {
-    pointer p = alloc(size);
+  MEMORY_CPP20CONSTEXPR pointer create_buffer(size_type& size) {
+    pointer p = alloc_at_least(size);
     try {
       safe_move(p, ptr_, ptr_ + size_);
     } catch(...) {
@@ -751,8 +782,8 @@ class vector {
 
   // T is MoveInsertable
   template <typename FwdIt>
-  MEMORY_CPP20CONSTEXPR typename std::enable_if<std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<FwdIt>::iterator_category>::value, pointer>::type create_buffer(size_type size, size_type ind, FwdIt first, FwdIt last) {
-    pointer p = alloc(size);
+  MEMORY_CPP20CONSTEXPR typename std::enable_if<std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<FwdIt>::iterator_category>::value, pointer>::type create_buffer(size_type& size, size_type ind, FwdIt first, FwdIt last) {
+    pointer p = alloc_at_least(size);
     try {
       fill(p + ind, first, last);
     } catch(...) {
@@ -764,12 +795,12 @@ class vector {
 
   // T is Emplaceonstructible
   template <typename... Args>
-  MEMORY_CPP20CONSTEXPR pointer create_buffer(size_type size, size_type count, size_type ind, Args&&... args) {
-    pointer p = alloc(size);
+  MEMORY_CPP20CONSTEXPR pointer create_buffer(size_type& size, size_type count, size_type ind, Args&&... args) {
+    pointer p = alloc_at_least(size);
     try {
       construct(p + ind, count, std::forward<Args>(args)...);
     } catch(...) {
-      dealloc(p, count);
+      dealloc(p, size);
       throw;
     }
     return p;
@@ -786,6 +817,20 @@ class vector {
     }
   }
 
+  // Grows the buffer to count objects in place if Allocator has
+  // try_expand(ptr, old_count, new_count) and it succeeds
+  MEMORY_CPP20CONSTEXPR bool expand(size_type count) noexcept {
+    if constexpr (has_try_expand<Allocator>::value) {
+      if (ptr_ && al_.try_expand(ptr_, cap_, count)) {
+        MEMORY_RECORD_EVENT(alloc_event::kReallocate, count*sizeof(T), 0, 0, cap_*sizeof(T));
+        cap_ = count;
+        return true;
+      }
+    }
+    (void)count;
+    return false;
+  }
+
   // No additional requirements on template types
   MEMORY_CPP20CONSTEXPR void swap_out_buffer(pointer new_buf, size_type size) {
     if (new_buf == ptr_) {
@@ -793,6 +838,7 @@ class vector {
     }
     std::swap(new_buf, ptr_);
     std::swap(size, cap_);
+    MEMORY_RECORD_EVENT(alloc_event::kReallocate, cap_*sizeof(T), 0, 0, size*sizeof(T));
     destroy(new_buf, size_);
     dealloc(new_buf, size);
   }
@@ -808,6 +854,21 @@ class vector {
     }  
   }
 
+  template <typename A, typename = void>
+  struct has_try_expand : std::false_type {};
+
+  template <typename A>
+  struct has_try_expand<A, std::void_t<decltype(
+      std::declval<A&>().try_expand(std::declval<T*>(), size_type(), size_type()))>>
+      : std::true_type {};
+
+  template <typename A, typename = void>
+  struct has_allocate_at_least : std::false_type {};
+
+  template <typename A>
+  struct has_allocate_at_least<A, std::void_t<decltype(
+      std::declval<A&>().allocate_at_least(size_type()).count)>> : std::true_type {};
+
   size_type size_;
   size_type cap_;
   allocator_type al_;
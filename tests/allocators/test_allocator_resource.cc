@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <list>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "memory/allocators/allocator_resource.h"
+#include "memory/allocators/buddy_allocator.h"
+#include "memory/allocators/caching_pool_allocator.h"
+#include "memory/allocators/monotonic_allocator.h"
+#include "memory/allocators/pool_allocator.h"
+#include "memory/allocators/slab_allocator.h"
+#include "memory/containers/vector.h"
+#include "../test_helpers.h"
+
+TEST(AllocatorResource, shared_pool) {
+  memory::pool_allocator<subject> al(1 << 16);
+  {
+    memory::allocator_resource<memory::pool_allocator<subject>> res(al);
+    std::pmr::vector<int> pmr_vec(&res);
+    memory::vector<subject, memory::pool_allocator<subject>> vec(al);
+
+    pmr_vec.resize(100);
+    ASSERT_EQ(al.allocd(), (100*sizeof(int) + alignof(int) - 1) / alignof(int) * alignof(int));
+    vec.emplace_back("first");
+    ASSERT_GT(al.allocd(), 100*sizeof(int));
+    ASSERT_EQ(res.get_allocator(), memory::pool_allocator<std::byte>(al));
+  }
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(AllocatorResource, alignment) {
+  memory::pool_allocator<uint8_t> al(1 << 16);
+  memory::allocator_resource<memory::pool_allocator<uint8_t>> res(al);
+
+  void* p = res.allocate(10, 256);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 256, 0);
+  res.deallocate(p, 10, 256);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(AllocatorResource, std_allocator) {
+  memory::allocator_resource<std::allocator<int>> res{std::allocator<int>()};
+
+  void* p = res.allocate(100, alignof(std::max_align_t));
+  res.deallocate(p, 100, alignof(std::max_align_t));
+  ASSERT_THROW((void)res.allocate(100, 2*alignof(std::max_align_t)), std::bad_alloc);
+}
+
+TEST(AllocatorResource, is_equal) {
+  memory::pool_allocator<uint8_t> al(1024);
+  memory::pool_allocator<uint8_t> other(1024);
+  memory::allocator_resource<memory::pool_allocator<uint8_t>> lhs(al);
+  memory::allocator_resource<memory::pool_allocator<uint64_t>> rhs(al);
+  memory::allocator_resource<memory::pool_allocator<uint8_t>> same(memory::pool_allocator<uint8_t>{al});
+  memory::allocator_resource<memory::pool_allocator<uint8_t>> diff(other);
+
+  ASSERT_TRUE(lhs.is_equal(lhs));
+  ASSERT_TRUE(lhs.is_equal(same));
+  ASSERT_FALSE(lhs.is_equal(diff));
+  ASSERT_FALSE(lhs.is_equal(*std::pmr::new_delete_resource()));
+  ASSERT_FALSE(lhs.is_equal(rhs));
+}
+
+TEST(AllocatorResource, slab_nodes) {
+  memory::slab_allocator<uint8_t> al(1 << 16);
+  {
+    memory::allocator_resource<memory::slab_allocator<uint8_t>> res(al);
+    std::pmr::list<int> list(&res);
+    for (int i = 0; i < 100; ++i) {
+      list.push_back(i);
+    }
+    ASSERT_EQ(al.allocd(), memory::slab_state::kSlabBytes);
+  }
+}
+
+TEST(AllocatorResource, other_allocators) {
+  memory::buddy_allocator<uint8_t> buddy(1 << 16);
+  memory::caching_pool_allocator<uint8_t> caching(1 << 16);
+  memory::monotonic_allocator<uint8_t> monotonic;
+  memory::allocator_resource<memory::buddy_allocator<uint8_t>> buddy_res(buddy);
+  memory::allocator_resource<memory::caching_pool_allocator<uint8_t>> caching_res(caching);
+  memory::allocator_resource<memory::monotonic_allocator<uint8_t>> monotonic_res(monotonic);
+
+  for (std::pmr::memory_resource* res : {static_cast<std::pmr::memory_resource*>(&buddy_res),
+                                         static_cast<std::pmr::memory_resource*>(&caching_res),
+                                         static_cast<std::pmr::memory_resource*>(&monotonic_res)}) {
+    std::pmr::vector<std::pmr::string> strings(res);
+    for (int i = 0; i < 50; ++i) {
+      strings.emplace_back(std::string(40, 'a' + i % 26));
+    }
+    ASSERT_EQ(strings[27], std::pmr::string(40, 'b'));
+  }
+  caching.flush();
+  ASSERT_EQ(buddy.allocd(), 0);
+  ASSERT_EQ(caching.allocd(), 0);
+}
+
+TEST(AllocatorResource, pool_upstream) {
+  std::pmr::monotonic_buffer_resource upstream;
+  memory::pool_options options;
+  options.growable = true;
+  options.upstream = &upstream;
+  memory::pool_allocator<uint8_t> al(1024, options);
+
+  uint8_t* a = al.allocate(1024);
+  uint8_t* b = al.allocate(1024);
+  ASSERT_EQ(al.segments(), 2);
+  al.deallocate(a, 1024);
+  al.deallocate(b, 1024);
+}
+
+TEST(AllocatorResource, pool_over_pool) {
+  memory::pool_allocator<uint8_t> outer(1 << 16);
+  {
+    memory::allocator_resource<memory::pool_allocator<uint8_t>> res(outer);
+    memory::pool_options options;
+    options.block_size = 16;
+    options.upstream = &res;
+    memory::pool_allocator<subject> inner(1024, options);
+    ASSERT_GT(outer.allocd(), 1024);
+    inner.deallocate(inner.allocate(4), 4);
+  }
+  ASSERT_EQ(outer.allocd(), 0);
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "memory/allocators/buddy_allocator.h"
+#include "memory/containers/vector.h"
+#include "../test_helpers.h"
+
+TEST(BuddyAlloc, ctor) {
+  constexpr int64_t size = 1024;
+  memory::buddy_allocator<uint8_t> al(size);
+
+  ASSERT_EQ(al.max_size(), size);
+  ASSERT_EQ(al.min_block(), 16);
+  al.deallocate(al.allocate(size), size);
+  ASSERT_THROW(al.allocate(size + 1), std::bad_alloc);
+  ASSERT_THROW(memory::buddy_allocator<uint8_t>(size, 8), std::invalid_argument);
+  ASSERT_THROW(memory::buddy_allocator<uint8_t>(size, 24), std::invalid_argument);
+}
+
+TEST(BuddyAlloc, ctor_copy) {
+  constexpr int64_t size = 32*sizeof(subject);
+  memory::buddy_allocator<subject> al(size);
+  memory::buddy_allocator<subject> cpy(al);
+
+  ASSERT_EQ(al, cpy);
+  subject* ptr = al.allocate(4);
+  ASSERT_EQ(cpy.allocd(), al.allocd());
+  cpy.deallocate(ptr, 4);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(BuddyAlloc, swap) {
+  memory::buddy_allocator<subject> lhs(1024);
+  memory::buddy_allocator<subject> rhs(2048);
+  memory::buddy_allocator<subject> lhs_cpy(lhs);
+  memory::buddy_allocator<subject> rhs_cpy(rhs);
+
+  using std::swap;
+  swap(lhs, rhs);
+  ASSERT_EQ(rhs, lhs_cpy);
+  ASSERT_EQ(lhs, rhs_cpy);
+}
+
+TEST(BuddyAlloc, split_merge) {
+  constexpr int64_t size = 1024;
+  memory::buddy_allocator<uint8_t> al(size);
+
+  uint8_t* a = al.allocate(16);
+  uint8_t* b = al.allocate(16);
+  uint8_t* c = al.allocate(100);
+  ASSERT_EQ(b, a + 16);
+  ASSERT_EQ(c, a + 128);
+  ASSERT_EQ(al.allocd(), 16 + 16 + 128);
+  al.deallocate(a, 16);
+  al.deallocate(b, 16);
+  uint8_t* d = al.allocate(32);
+  ASSERT_EQ(d, a);
+  al.deallocate(d, 32);
+  al.deallocate(c, 100);
+  ASSERT_EQ(al.allocd(), 0);
+  uint8_t* all = al.allocate(size);
+  ASSERT_EQ(all, a);
+  al.deallocate(all, size);
+}
+
+TEST(BuddyAlloc, not_power_of_two) {
+  constexpr int64_t size = 16*7;
+  memory::buddy_allocator<uint8_t> al(size);
+
+  ASSERT_THROW(al.allocate(65), std::bad_alloc);
+  uint8_t* big = al.allocate(64);
+  uint8_t* mid = al.allocate(32);
+  uint8_t* small = al.allocate(16);
+  ASSERT_EQ(mid, big + 64);
+  ASSERT_EQ(small, big + 96);
+  ASSERT_EQ(al.remaining(), 0);
+  ASSERT_THROW(al.allocate(1), std::bad_alloc);
+  al.deallocate(mid, 32);
+  al.deallocate(small, 16);
+  al.deallocate(big, 64);
+  ASSERT_EQ(al.remaining(), size);
+}
+
+TEST(BuddyAlloc, alloc_aligned) {
+  constexpr int64_t size = 1 << 16;
+  memory::buddy_allocator<uint8_t> al(size);
+
+  uint8_t* first = al.allocate(1);
+  for (std::size_t align : {32, 64, 256, 4096}) {
+    uint8_t* p = al.allocate(10, align);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % align, 0);
+    al.deallocate(p, 10);
+  }
+  ASSERT_THROW(al.allocate(10, 3), std::invalid_argument);
+  ASSERT_THROW(al.allocate(10, 8192), std::bad_alloc);
+  al.deallocate(first, 1);
+}
+
+TEST(BuddyAlloc, alloc_random) {
+  constexpr int64_t size = 1 << 16;
+  memory::buddy_allocator<uint8_t> al(size);
+  std::vector<std::pair<uint8_t*, std::size_t>> held;
+  std::mt19937 gen(3);
+
+  for (int i = 0; i < 5000; ++i) {
+    if (held.empty() || gen() % 2) {
+      std::size_t count = 1 + gen() % 2000;
+      try {
+        uint8_t* p = al.allocate(count);
+        std::fill(p, p + count, static_cast<uint8_t>(i));
+        held.emplace_back(p, count);
+      } catch (std::bad_alloc&) {}
+    } else {
+      std::size_t idx = gen() % held.size();
+      al.deallocate(held[idx].first, held[idx].second);
+      held.erase(held.begin() + idx);
+    }
+  }
+  std::sort(held.begin(), held.end());
+  for (std::size_t i = 1; i < held.size(); ++i) {
+    ASSERT_LE(held[i - 1].first + held[i - 1].second, held[i].first);
+  }
+  for (auto& [p, count] : held) {
+    al.deallocate(p, count);
+  }
+  ASSERT_EQ(al.allocd(), 0);
+  al.deallocate(al.allocate(size), size);
+}
+
+TEST(BuddyAlloc, rebind) {
+  using traits = std::allocator_traits<memory::buddy_allocator<subject>>;
+  using rebind = traits::rebind_alloc<large>;
+
+  memory::buddy_allocator<subject> al(1 << 12);
+  rebind al_rebind(al);
+  large* l = al_rebind.allocate(2);
+  subject* s = al.allocate(2);
+  ASSERT_EQ(al.allocd(), al_rebind.allocd());
+  al.deallocate(s, 2);
+  al_rebind.deallocate(l, 2);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(BuddyAlloc, allocate_at_least) {
+  memory::buddy_allocator<uint32_t> al(1024);
+  auto res = al.allocate_at_least(5);
+  ASSERT_EQ(res.count, 8);
+  ASSERT_EQ(al.allocd(), 32);
+  auto big = al.allocate_at_least(100);
+  ASSERT_EQ(big.count, 128);
+  ASSERT_EQ(al.allocd(), 32 + 512);
+  al.deallocate(big.ptr, big.count);
+  al.deallocate(res.ptr, 5);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(BuddyAlloc, with_vector) {
+  memory::buddy_allocator<subject> al(1 << 16);
+  {
+    memory::vector<subject, memory::buddy_allocator<subject>> vec(al);
+    for (int i = 0; i < 200; ++i) {
+      vec.emplace_back(std::to_string(i));
+    }
+    ASSERT_EQ(vec[142], subject("142"));
+  }
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(BuddyAlloc, alloc_leak) {
+  bool passed = false;
+  try {
+    memory::buddy_allocator<subject> al(1 << 12);
+    al.allocate(4);
+  } catch (std::runtime_error& e) {
+    passed = true;
+  }
+  ASSERT_TRUE(passed);
+}
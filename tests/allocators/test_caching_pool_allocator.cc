@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "memory/allocators/caching_pool_allocator.h"
+#include "../test_helpers.h"
+
+TEST(CachingPoolAlloc, ctor) {
+  constexpr int64_t size = 1 << 16;
+  memory::caching_pool_allocator<uint8_t> al(size);
+
+  ASSERT_EQ(al.max_size(), size);
+  al.deallocate(al.allocate(size), size);
+  ASSERT_THROW(al.allocate(size + 1), std::bad_alloc);
+}
+
+TEST(CachingPoolAlloc, reuse_cached) {
+  constexpr int64_t size = 1 << 16;
+  constexpr std::size_t cls = (sizeof(subject) + 15) / 16 * 16;
+  constexpr std::size_t batch = memory::pool_cache_state::kBatchBytes / cls * cls;
+  memory::caching_pool_allocator<subject> al(size);
+
+  subject* first = al.allocate(1);
+  ASSERT_EQ(al.allocd(), batch);
+  al.deallocate(first, 1);
+  ASSERT_EQ(al.allocd(), batch);
+  ASSERT_EQ(al.allocate(1), first);
+  subject* second = al.allocate(1);
+  ASSERT_NE(second, first);
+  al.deallocate(second, 1);
+  al.deallocate(first, 1);
+  al.flush();
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(CachingPoolAlloc, large_bypass) {
+  constexpr int64_t size = 1 << 16;
+  memory::caching_pool_allocator<large> al(size);
+
+  large* ptr = al.allocate(100);
+  ASSERT_EQ(al.allocd(), (100*sizeof(large) + 15) / 16 * 16);
+  al.deallocate(ptr, 100);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(CachingPoolAlloc, rebind_shares_cache) {
+  constexpr int64_t size = 1 << 16;
+  memory::caching_pool_allocator<uint64_t> al(size);
+  memory::caching_pool_allocator<std::pair<uint32_t, uint32_t>> al_rebind(al);
+
+  ASSERT_EQ(al, memory::caching_pool_allocator<uint64_t>(al_rebind));
+  uint64_t* ptr = al.allocate(1);
+  al.deallocate(ptr, 1);
+  ASSERT_EQ(static_cast<void*>(al_rebind.allocate(1)), static_cast<void*>(ptr));
+  al_rebind.deallocate(reinterpret_cast<std::pair<uint32_t, uint32_t>*>(ptr), 1);
+}
+
+TEST(CachingPoolAlloc, drain_long_list) {
+  constexpr int64_t size = 1 << 16;
+  constexpr std::size_t count = 5*memory::pool_cache_state::kBatchBytes / 16;
+  memory::caching_pool_allocator<uint8_t> al(size);
+
+  std::vector<uint8_t*> ptrs;
+  for (std::size_t i = 0; i < count; ++i) {
+    ptrs.push_back(al.allocate(16));
+  }
+  ASSERT_EQ(al.allocd(), 5*memory::pool_cache_state::kBatchBytes);
+  // Drained batches are coalesced into runs whatever the order of the list
+  std::shuffle(ptrs.begin(), ptrs.end(), std::mt19937(3));
+  for (uint8_t* p : ptrs) {
+    al.deallocate(p, 16);
+  }
+  ASSERT_LE(al.allocd(), 2*memory::pool_cache_state::kBatchBytes);
+  al.flush();
+  ASSERT_EQ(al.allocd(), 0);
+  al.deallocate(al.allocate(size), size);
+}
+
+TEST(CachingPoolAlloc, flush_on_thread_exit) {
+  constexpr int64_t size = 1 << 16;
+  memory::caching_pool_allocator<subject> al(size);
+
+  std::thread worker([&al] {
+    subject* p = al.allocate(2);
+    al.deallocate(p, 2);
+  });
+  worker.join();
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(CachingPoolAlloc, destroy_before_thread_exit) {
+  std::atomic<int> stage{0};
+  auto* al = new memory::caching_pool_allocator<subject>(1 << 16);
+
+  std::thread worker([&stage, al] {
+    al->deallocate(al->allocate(1), 1);
+    stage = 1;
+    while (stage != 2) std::this_thread::yield();
+  });
+  while (stage != 1) std::this_thread::yield();
+  ASSERT_NO_THROW(delete al);
+  stage = 2;
+  worker.join();
+}
+
+TEST(CachingPoolAlloc, alloc_leak) {
+  bool passed = false;
+  try {
+    memory::caching_pool_allocator<subject> al(1 << 16);
+    al.allocate(4);
+  } catch (std::runtime_error& e) {
+    passed = true;
+  }
+  ASSERT_TRUE(passed);
+}
+
+TEST(CachingPoolAlloc, threads) {
+  constexpr std::size_t threads = 16;
+  constexpr std::size_t rounds = 5000;
+  memory::caching_pool_allocator<uint64_t> al(1 << 22);
+  std::vector<std::size_t> failures(threads);
+
+  std::vector<std::thread> pool;
+  for (std::size_t t = 0; t < threads; ++t) {
+    pool.emplace_back([&, t] {
+      std::vector<std::pair<uint64_t*, std::size_t>> held;
+      for (std::size_t i = 0; i < rounds; ++i) {
+        std::size_t count = 1 + (i + t) % 24;
+        uint64_t* p = al.allocate(count);
+        std::fill(p, p + count, t);
+        held.emplace_back(p, count);
+        if (held.size() == 64) {
+          for (auto& [ptr, n] : held) {
+            failures[t] += std::count(ptr, ptr + n, t) != static_cast<int64_t>(n);
+            al.deallocate(ptr, n);
+          }
+          held.clear();
+        }
+      }
+      for (auto& [ptr, n] : held) al.deallocate(ptr, n);
+    });
+  }
+  for (auto& th : pool) th.join();
+  ASSERT_EQ(std::count(failures.begin(), failures.end(), 0), threads);
+  ASSERT_EQ(al.allocd(), 0);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "memory/allocators/concurrent_pool_allocator.h"
+#include "../test_helpers.h"
+
+TEST(ConcurrentPoolAlloc, ctor) {
+  constexpr int64_t size = 1024;
+  memory::concurrent_pool_allocator<uint8_t> al(size);
+
+  ASSERT_EQ(al.max_size(), size);
+  al.deallocate(al.allocate(size), size);
+  ASSERT_THROW(al.allocate(size + 1), std::bad_alloc);
+}
+
+TEST(ConcurrentPoolAlloc, ctor_copy) {
+  constexpr int64_t size = 20*sizeof(subject);
+  constexpr int64_t count = 20;
+  memory::concurrent_pool_allocator<subject> al(size);
+  memory::concurrent_pool_allocator<subject> cpy(al);
+
+  ASSERT_EQ(al, cpy);
+  subject* ptr = al.allocate(count);
+  ASSERT_EQ(cpy.remaining(), 0);
+  cpy.deallocate(ptr, count);
+  ASSERT_THROW(cpy.allocate(count + 1), std::bad_alloc);
+}
+
+TEST(ConcurrentPoolAlloc, rebind) {
+  using traits = std::allocator_traits<memory::concurrent_pool_allocator<subject>>;
+  using rebind = typename traits::template rebind_alloc<large>;
+
+  constexpr int64_t size = 20*sizeof(subject) + 10*sizeof(large);
+  memory::concurrent_pool_allocator<subject> al(size);
+  rebind al_rebind(al);
+
+  subject* s = al.allocate(3);
+  large* l = al_rebind.allocate(2);
+  ASSERT_EQ(al.allocd(), 3*sizeof(subject) + 2*sizeof(large));
+  al_rebind.deallocate(l, 2);
+  al.deallocate(s, 3);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(ConcurrentPoolAlloc, alloc_aligned) {
+  memory::concurrent_pool_allocator<uint8_t> al(4096, 16);
+
+  uint8_t* b = al.allocate(1);
+  uint8_t* line = al.allocate(100, 64);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(line) % 64, 0);
+  ASSERT_EQ(al.allocd(), 16 + 112);
+  al.deallocate(line, 100);
+  al.deallocate(b, 1);
+}
+
+TEST(ConcurrentPoolAlloc, alloc_leak) {
+  bool passed = false;
+  try {
+    memory::concurrent_pool_allocator<subject> al(20*sizeof(subject));
+    al.allocate(4);
+  } catch (std::runtime_error& e) {
+    passed = true;
+  }
+  ASSERT_TRUE(passed);
+}
+
+// Every thread repeatedly takes blocks of varying size, stamps them with its
+// id and checks nobody else wrote there before giving them back
+TEST(ConcurrentPoolAlloc, threads_scalability) {
+  constexpr std::size_t rounds = 2000;
+  constexpr std::size_t per_thread = 32;
+  for (std::size_t threads : {1, 2, 4, 8, 16, 32}) {
+    memory::concurrent_pool_allocator<uint32_t> al(threads*per_thread*64*sizeof(uint32_t), 16);
+    std::vector<std::size_t> failures(threads);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (std::size_t t = 0; t < threads; ++t) {
+      pool.emplace_back([&, t] {
+        memory::concurrent_pool_allocator<uint32_t> local(al);
+        std::vector<std::pair<uint32_t*, std::size_t>> held;
+        for (std::size_t i = 0; i < rounds; ++i) {
+          std::size_t count = 1 + (i*7 + t) % 40;
+          uint32_t* p = local.allocate(count);
+          std::fill(p, p + count, static_cast<uint32_t>(t));
+          held.emplace_back(p, count);
+          if (held.size() == per_thread || i + 1 == rounds) {
+            for (auto& [ptr, n] : held) {
+              if (std::count(ptr, ptr + n, static_cast<uint32_t>(t)) != static_cast<int64_t>(n)) {
+                ++failures[t];
+              }
+              local.deallocate(ptr, n);
+            }
+            held.clear();
+          }
+        }
+      });
+    }
+    for (auto& th : pool) th.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(std::count(failures.begin(), failures.end(), 0), threads);
+    ASSERT_EQ(al.allocd(), 0);
+    RecordProperty("ops_per_sec_" + std::to_string(threads),
+                   std::to_string(static_cast<int64_t>(2*rounds*threads / elapsed.count())));
+  }
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "memory/allocators/event_recorder.h"
+#include "memory/allocators/pool_allocator.h"
+#include "memory/containers/vector.h"
+
+static const char* kTracePath = "test_event_recorder.trace";
+
+TEST(EventRecorder, record) {
+  ASSERT_TRUE(memory::event_recorder::open(kTracePath));
+  ASSERT_TRUE(memory::event_recorder::recording());
+  memory::event_recorder::record(memory::alloc_event::kAllocate, 16, 64, 3);
+  std::thread worker([] {
+    for (uint64_t i = 0; i < 3*memory::event_recorder::kRingSize; ++i) {
+      memory::event_recorder::record(memory::alloc_event::kDeallocate, i, i, 4);
+    }
+  });
+  worker.join();
+  memory::event_recorder::record(memory::alloc_event::kReallocate, 32, 0, 0, 16);
+  memory::event_recorder::close();
+  ASSERT_FALSE(memory::event_recorder::recording());
+  memory::event_recorder::record(memory::alloc_event::kAllocate, 1, 1, 1);
+
+  std::vector<memory::alloc_event> events = memory::event_recorder::load(kTracePath);
+  ASSERT_EQ(events.size() + memory::event_recorder::dropped(),
+            3*memory::event_recorder::kRingSize + 2);
+  // Worker drains its own ring, so its events may come first
+  auto first = std::find_if(events.begin(), events.end(),
+                            [](const memory::alloc_event& e) { return e.source == 3; });
+  ASSERT_NE(first, events.end());
+  ASSERT_EQ(first->kind, memory::alloc_event::kAllocate);
+  ASSERT_EQ(first->size, 16);
+  ASSERT_EQ(first->offset, 64);
+  ASSERT_EQ(first->old_size, 0);
+  ASSERT_EQ(first[1].kind, memory::alloc_event::kReallocate);
+  ASSERT_EQ(first[1].size, 32);
+  ASSERT_EQ(first[1].old_size, 16);
+  ASSERT_EQ(first[1].thread, first->thread);
+  ASSERT_LE(first->time, first[1].time);
+  uint64_t last = 0;
+  for (const memory::alloc_event& e : events) {
+    if (e.source == 4) {
+      ASSERT_NE(e.thread, first->thread);
+      ASSERT_TRUE(!last || e.size > last);
+      last = e.size;
+    }
+  }
+  std::remove(kTracePath);
+}
+
+TEST(EventRecorder, load_invalid) {
+  ASSERT_THROW(memory::event_recorder::load("missing.trace"), std::runtime_error);
+  std::FILE* file = std::fopen(kTracePath, "wb");
+  std::fputs("not a trace", file);
+  std::fclose(file);
+  ASSERT_THROW(memory::event_recorder::load(kTracePath), std::runtime_error);
+  std::remove(kTracePath);
+}
+
+TEST(EventRecorder, hooks) {
+  ASSERT_TRUE(memory::event_recorder::open(kTracePath));
+  {
+    memory::pool_allocator<uint32_t> al(1024, 16);
+    memory::vector<uint32_t, memory::pool_allocator<uint32_t>> vec(al);
+    vec.reserve(8);
+    vec.reserve(40);
+  }
+  memory::event_recorder::close();
+
+  std::vector<memory::alloc_event> events = memory::event_recorder::load(kTracePath);
+#if defined(MEMORY_ALLOC_EVENTS)
+  ASSERT_EQ(events.size(), 6);
+  ASSERT_EQ(events[0].kind, memory::alloc_event::kAllocate);
+  ASSERT_EQ(events[0].size, 32);
+  ASSERT_EQ(events[0].offset, 0);
+  ASSERT_NE(events[0].source, 0);
+  ASSERT_EQ(events[1].kind, memory::alloc_event::kReallocate);
+  // Second reserve grows the buffer in place
+  ASSERT_EQ(events[2].kind, memory::alloc_event::kDeallocate);
+  ASSERT_EQ(events[2].size, 32);
+  ASSERT_EQ(events[2].offset, 0);
+  ASSERT_EQ(events[3].kind, memory::alloc_event::kAllocate);
+  ASSERT_EQ(events[3].size, 160);
+  ASSERT_EQ(events[3].offset, 0);
+  ASSERT_EQ(events[4].kind, memory::alloc_event::kReallocate);
+  ASSERT_EQ(events[4].size, 160);
+  ASSERT_EQ(events[4].old_size, 32);
+  ASSERT_EQ(events[4].offset, 0);
+  ASSERT_EQ(events[5].kind, memory::alloc_event::kDeallocate);
+  ASSERT_EQ(events[5].offset, 0);
+#else
+  ASSERT_TRUE(events.empty());
+#endif
+  std::remove(kTracePath);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <list>
+
+#include "memory/allocators/monotonic_allocator.h"
+#include "memory/containers/vector.h"
+#include "../test_helpers.h"
+
+TEST(MonotonicAlloc, ctor) {
+  memory::monotonic_allocator<uint8_t> al;
+
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.remaining(), 0);
+  uint8_t* p = al.allocate(100);
+  ASSERT_EQ(al.allocd(), 100);
+  ASSERT_GE(al.remaining(), memory::monotonic_allocator<uint8_t>::kDefaultBlockSize - 200);
+  al.deallocate(p, 100);
+  ASSERT_EQ(al.allocd(), 100);
+}
+
+TEST(MonotonicAlloc, bump) {
+  memory::monotonic_allocator<uint8_t> al(1024);
+
+  uint8_t* a = al.allocate(10);
+  uint8_t* b = al.allocate(10);
+  ASSERT_EQ(b, a + 10);
+  uint64_t* c = memory::monotonic_allocator<uint64_t>(al).allocate(1);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(c) % alignof(uint64_t), 0);
+  ASSERT_GE(reinterpret_cast<uint8_t*>(c), b + 10);
+  uint8_t* d = al.allocate(4, 256);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(d) % 256, 0);
+  ASSERT_THROW(al.allocate(1, 3), std::invalid_argument);
+  std::size_t huge = (std::numeric_limits<std::size_t>::max() >> 1) + 1;
+  ASSERT_THROW(al.allocate(al.max_size(), huge), std::bad_alloc);
+  ASSERT_THROW(al.allocate(1, huge), std::bad_alloc);
+}
+
+TEST(MonotonicAlloc, chain_blocks) {
+  memory::monotonic_allocator<uint8_t> al(256);
+
+  uint8_t* first = al.allocate(200);
+  uint8_t* second = al.allocate(200);
+  ASSERT_NE(second, first + 200);
+  ASSERT_GE(al.remaining(), 200);
+  uint8_t* huge = al.allocate(1 << 16);
+  huge[(1 << 16) - 1] = 1;
+  ASSERT_EQ(al.allocd(), 400 + (1 << 16));
+  al.release();
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.remaining(), 0);
+  al.allocate(10);
+}
+
+TEST(MonotonicAlloc, buffer) {
+  alignas(64) uint8_t buffer[512];
+  memory::monotonic_allocator<uint8_t> al(buffer, sizeof(buffer), 1024);
+
+  uint8_t* a = al.allocate(500);
+  ASSERT_EQ(a, buffer);
+  uint8_t* b = al.allocate(100);
+  ASSERT_TRUE(b < buffer || b >= buffer + sizeof(buffer));
+  al.release();
+  ASSERT_EQ(al.allocate(10), buffer);
+  ASSERT_EQ(al.remaining(), sizeof(buffer) - 10);
+}
+
+TEST(MonotonicAlloc, swap) {
+  memory::monotonic_allocator<subject> lhs;
+  memory::monotonic_allocator<subject> rhs;
+  memory::monotonic_allocator<subject> lhs_cpy(lhs);
+  memory::monotonic_allocator<subject> rhs_cpy(rhs);
+
+  using std::swap;
+  swap(lhs, rhs);
+  ASSERT_EQ(rhs, lhs_cpy);
+  ASSERT_EQ(lhs, rhs_cpy);
+}
+
+TEST(MonotonicAlloc, with_vector) {
+  memory::monotonic_allocator<subject> al(512);
+  {
+    memory::vector<subject, memory::monotonic_allocator<subject>> vec(al);
+    for (int i = 0; i < 200; ++i) {
+      vec.emplace_back(std::to_string(i));
+    }
+    ASSERT_EQ(vec[142], subject("142"));
+  }
+  ASSERT_GE(al.allocd(), 200*sizeof(subject));
+  al.release();
+}
+
+TEST(MonotonicAlloc, with_list) {
+  memory::monotonic_allocator<int> al;
+  std::list<int, memory::monotonic_allocator<int>> list(al);
+  for (int i = 0; i < 1000; ++i) list.push_back(i);
+  ASSERT_EQ(list.back(), 999);
+}
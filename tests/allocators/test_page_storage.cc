@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "memory/allocators/page_storage.h"
+
+TEST(PageStorage, map) {
+  std::size_t page = memory::page_storage::page_size();
+  std::size_t size = 3*page + 1;
+  void* p = memory::page_storage::map(size, 64, false);
+
+  ASSERT_EQ(size, 4*page);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % page, 0);
+  auto* bytes = static_cast<uint8_t*>(p);
+  ASSERT_EQ(bytes[0], 0);
+  ASSERT_EQ(bytes[size - 1], 0);
+  std::memset(p, 0xff, size);
+  memory::page_storage::unmap(p, size, 64, false);
+}
+
+TEST(PageStorage, map_aligned) {
+  constexpr std::size_t alignment = std::size_t(1) << 20;
+  std::size_t size = 1;
+  void* p = memory::page_storage::map(size, alignment, false);
+
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % alignment, 0);
+  static_cast<uint8_t*>(p)[0] = 1;
+  memory::page_storage::unmap(p, size, alignment, false);
+}
+
+TEST(PageStorage, map_huge) {
+  std::size_t size = 1;
+  void* p = memory::page_storage::map(size, 64, true);
+
+  ASSERT_EQ(size, memory::page_storage::kHugePageSize);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % memory::page_storage::kHugePageSize, 0);
+  std::memset(p, 1, size);
+  memory::page_storage::unmap(p, size, 64, true);
+}
+
+TEST(PageStorage, populate) {
+  std::size_t page = memory::page_storage::page_size();
+  std::size_t size = 8*page;
+  void* p = memory::page_storage::map(size, 64, false, true);
+  auto* bytes = static_cast<uint8_t*>(p);
+  bytes[page] = 5;
+
+  memory::page_storage::populate(bytes + 1, size - 1);
+  ASSERT_EQ(bytes[page], 5);
+  ASSERT_EQ(bytes[size - 1], 0);
+  if (memory::page_storage::lock(p, size)) {
+    memory::page_storage::unlock(p, size);
+  }
+  memory::page_storage::unmap(p, size, 64, false);
+}
@@ -1,5 +1,10 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <vector>
+
 #include "memory/allocators/pool_allocator.h"
 #include "../test_helpers.h"
 
@@ -277,3 +282,600 @@ TEST(PoolAlloc, alloc_leak) {
   }
 }
 
+
+TEST(PoolAlloc, alloc_fragmented) {
+  constexpr int64_t size = 1024;
+  memory::pool_allocator<uint8_t> al(size);
+
+  uint8_t* ptrs[size / 64];
+  for (int i = 0; i < size / 64; ++i) {
+    ptrs[i] = al.allocate(64);
+  }
+  ASSERT_EQ(al.remaining(), 0);
+  al.deallocate(ptrs[3], 64);
+  al.deallocate(ptrs[5], 64);
+  al.deallocate(ptrs[6], 64);
+  ASSERT_THROW(al.allocate(129), std::bad_alloc);
+  uint8_t* big = al.allocate(128);
+  ASSERT_EQ(big, ptrs[5]);
+  uint8_t* small = al.allocate(10);
+  ASSERT_EQ(small, ptrs[3]);
+  al.deallocate(small, 10);
+  al.deallocate(big, 128);
+  for (int i = 0; i < size / 64; ++i) {
+    if (i != 3 && i != 5 && i != 6) al.deallocate(ptrs[i], 64);
+  }
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolAlloc, block_size) {
+  constexpr int64_t size = 1000;
+  constexpr int64_t block = 16;
+  memory::pool_allocator<uint8_t> al(size, block);
+
+  ASSERT_EQ(al.block_size(), block);
+  ASSERT_EQ(al.max_size(), 1008);
+  ASSERT_EQ(al.remaining(), 1008);
+
+  uint8_t* first = al.allocate(3);
+  uint8_t* second = al.allocate(17);
+  uint8_t* third = al.allocate(16);
+  ASSERT_EQ(al.allocd(), 4*block);
+  ASSERT_EQ(second - first, block);
+  ASSERT_EQ(third - second, 2*block);
+
+  al.deallocate(second, 17);
+  ASSERT_EQ(al.allocate(32), second);
+  ASSERT_THROW(al.allocate(1008 - 3*block), std::bad_alloc);
+  al.deallocate(second, 32);
+  al.deallocate(first, 3);
+  al.deallocate(third, 16);
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.allocate(1008), first);
+  al.deallocate(first, 1008);
+}
+
+TEST(PoolAlloc, block_size_rebind) {
+  constexpr int64_t size = 20*sizeof(subject) + 10*sizeof(large);
+  memory::pool_allocator<subject> al(size, 64);
+  memory::pool_allocator<large> al_rebind(al);
+
+  ASSERT_EQ(al_rebind.block_size(), 64);
+  subject* s = al.allocate(1);
+  large* l = al_rebind.allocate(3);
+  ASSERT_EQ(al.allocd(), 64 + (3*sizeof(large) + 63) / 64 * 64);
+  al_rebind.deallocate(l, 3);
+  al.deallocate(s, 1);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolAlloc, block_size_invalid) {
+  ASSERT_THROW(memory::pool_allocator<uint8_t>(1024, 0), std::invalid_argument);
+  ASSERT_THROW(memory::pool_allocator<uint8_t>(1024, 24), std::invalid_argument);
+}
+
+TEST(PoolAlloc, alloc_aligned_rebind) {
+  constexpr int64_t size = 1024;
+  memory::pool_allocator<uint8_t> bytes(size);
+  memory::pool_allocator<double> doubles(bytes);
+
+  uint8_t* b = bytes.allocate(3);
+  double* d = doubles.allocate(4);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(d) % alignof(double), 0);
+  uint8_t* gap = bytes.allocate(5);
+  ASSERT_EQ(gap, b + 3);
+  doubles.deallocate(d, 4);
+  bytes.deallocate(gap, 5);
+  bytes.deallocate(b, 3);
+  ASSERT_EQ(bytes.allocd(), 0);
+}
+
+TEST(PoolAlloc, alloc_over_aligned) {
+  constexpr int64_t size = 16384;
+  memory::pool_allocator<uint8_t> al(size);
+
+  uint8_t* b = al.allocate(1);
+  for (std::size_t align : {32, 64, 256, 4096}) {
+    uint8_t* p = al.allocate(10, align);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % align, 0);
+    al.deallocate(p, 10);
+  }
+  ASSERT_THROW(al.allocate(10, 3), std::invalid_argument);
+  ASSERT_THROW(al.allocate(size, 64), std::bad_alloc);
+  al.deallocate(b, 1);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolAlloc, alloc_aligned_block_size) {
+  constexpr int64_t size = 4096;
+  memory::pool_allocator<uint8_t> al(size, 16);
+
+  uint8_t* first = al.allocate(1);
+  uint8_t* line = al.allocate(64, 64);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(first) % 64, 0);
+  ASSERT_EQ(line - first, 64);
+  uint8_t* filler = al.allocate(48);
+  ASSERT_EQ(filler, first + 16);
+  al.deallocate(filler, 48);
+  al.deallocate(line, 64);
+  al.deallocate(first, 1);
+}
+
+TEST(PoolAlloc, growable) {
+  constexpr int64_t size = 1024;
+  memory::pool_options options;
+  options.growable = true;
+  memory::pool_allocator<uint8_t> al(size, options);
+
+  uint8_t* first = al.allocate(size);
+  ASSERT_EQ(al.segments(), 1);
+  uint8_t* second = al.allocate(size);
+  ASSERT_EQ(al.segments(), 2);
+  ASSERT_EQ(al.remaining(), size);
+  uint8_t* third = al.allocate(size + 1);
+  ASSERT_EQ(al.segments(), 3);
+  ASSERT_EQ(al.allocd(), 3*size + 1);
+  ASSERT_EQ(al.remaining(), 4*size - 1);
+  uint8_t* fourth = al.allocate(size);
+  ASSERT_EQ(al.segments(), 3);
+  al.deallocate(second, size);
+  al.deallocate(first, size);
+  al.deallocate(fourth, size);
+  al.deallocate(third, size + 1);
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.segments(), 3);
+}
+
+TEST(PoolAlloc, growable_large_request) {
+  constexpr int64_t size = 1024;
+  memory::pool_options options;
+  options.growable = true;
+  memory::pool_allocator<uint8_t> al(size, options);
+
+  uint8_t* big = al.allocate(100*size);
+  uint8_t* aligned = al.allocate(10, 8192);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 8192, 0);
+  al.deallocate(aligned, 10);
+  al.deallocate(big, 100*size);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolAlloc, growable_release_empty) {
+  constexpr int64_t size = 64*sizeof(subject);
+  memory::pool_options options;
+  options.growable = true;
+  options.release_empty = true;
+  memory::pool_allocator<subject> al(size, options);
+
+  std::vector<subject*> ptrs;
+  for (int i = 0; i < 64*7; ++i) {
+    ptrs.push_back(al.allocate(1));
+  }
+  ASSERT_EQ(al.segments(), 3);
+  for (subject* p : ptrs) {
+    al.deallocate(p, 1);
+  }
+  ASSERT_EQ(al.segments(), 1);
+  ASSERT_EQ(al.remaining(), size);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolAlloc, growable_rebind) {
+  constexpr int64_t size = 4*sizeof(large);
+  memory::pool_options options;
+  options.growable = true;
+  options.block_size = 16;
+  memory::pool_allocator<large> al(size, options);
+  memory::pool_allocator<subject> al_rebind(al);
+
+  large* l = al.allocate(4);
+  subject* s = al_rebind.allocate(4);
+  ASSERT_EQ(al.segments(), 2);
+  al.deallocate(l, 4);
+  al_rebind.deallocate(s, 4);
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_GT(al.max_size(), size);
+}
+
+TEST(PoolAlloc, growable_leak) {
+  bool passed = false;
+  try {
+    memory::pool_options options;
+    options.growable = true;
+    memory::pool_allocator<uint8_t> al(64, options);
+    al.allocate(64);
+    al.allocate(64);
+  } catch (std::runtime_error& e) {
+    passed = true;
+  }
+  ASSERT_TRUE(passed);
+}
+
+TEST(PoolAlloc, growable_invalid) {
+  memory::pool_options options;
+  options.growable = true;
+  options.growth_factor = 0;
+  ASSERT_THROW(memory::pool_allocator<uint8_t>(64, options), std::invalid_argument);
+}
+
+TEST(PoolAlloc, mapped) {
+  constexpr int64_t size = 10000;
+  memory::pool_options options;
+  options.mapped = true;
+  memory::pool_allocator<uint64_t> al(size, options);
+
+  std::size_t page = memory::page_storage::page_size();
+  ASSERT_EQ(al.max_size()*sizeof(uint64_t), (size + page - 1) / page * page);
+  uint64_t* p = al.allocate(al.max_size());
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % page, 0);
+  ASSERT_EQ(p[100], 0);
+  p[al.max_size() - 1] = 1;
+  ASSERT_THROW(al.allocate(1), std::bad_alloc);
+  al.deallocate(p, al.max_size());
+}
+
+TEST(PoolAlloc, mapped_huge_pages) {
+  memory::pool_options options;
+  options.huge_pages = true;
+  options.growable = true;
+  memory::pool_allocator<uint8_t> al(1 << 20, options);
+
+  ASSERT_EQ(al.remaining(), memory::page_storage::kHugePageSize);
+  uint8_t* p = al.allocate(al.remaining());
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % memory::page_storage::kHugePageSize, 0);
+  p[0] = 1;
+  uint8_t* q = al.allocate(10);
+  ASSERT_EQ(al.segments(), 2);
+  al.deallocate(q, 10);
+  al.deallocate(p, memory::page_storage::kHugePageSize);
+}
+
+TEST(PoolAlloc, mapped_block_size) {
+  memory::pool_options options;
+  options.mapped = true;
+  options.block_size = 1 << 14;
+  memory::pool_allocator<uint8_t> al(1, options);
+
+  ASSERT_EQ(al.remaining(), 1 << 14);
+  uint8_t* p = al.allocate(1);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % (1 << 14), 0);
+  al.deallocate(p, 1);
+}
+
+TEST(PoolAlloc, mapped_invalid) {
+  memory::pool_options options;
+  options.mapped = true;
+  options.upstream = std::pmr::new_delete_resource();
+  ASSERT_THROW(memory::pool_allocator<uint8_t>(64, options), std::invalid_argument);
+}
+
+TEST(PoolAlloc, trim) {
+  std::size_t page = memory::page_storage::page_size();
+  memory::pool_options options;
+  options.mapped = true;
+  memory::pool_allocator<uint8_t> al(16*page, options);
+
+  uint8_t* head = al.allocate(page + 1);
+  uint8_t* body = al.allocate(10*page);
+  std::fill(body, body + 10*page, 1);
+  ASSERT_EQ(al.trim(), 4*page);
+  al.deallocate(body, 10*page);
+  ASSERT_EQ(al.trim(), 10*page);
+  ASSERT_EQ(al.trim(), 0);
+  uint8_t* again = al.allocate(3*page);
+  ASSERT_EQ(again, body);
+  ASSERT_EQ(again[page - 1], 0);
+  al.deallocate(again, 3*page);
+  ASSERT_EQ(al.trim(), 3*page);
+  al.deallocate(head, page + 1);
+  ASSERT_EQ(al.trim(), 2*page);
+}
+
+TEST(PoolAlloc, trim_delay) {
+  std::size_t page = memory::page_storage::page_size();
+  memory::pool_options options;
+  options.mapped = true;
+  options.trim_delay = 3;
+  options.lazy_trim = true;
+  memory::pool_allocator<uint8_t> al(4*page, options);
+
+  ASSERT_EQ(al.trim(), 0);
+  uint8_t* hot = al.allocate(page);
+  ASSERT_EQ(al.trim(), 0);
+  ASSERT_EQ(al.trim(), 3*page);
+  al.deallocate(hot, page);
+  ASSERT_EQ(al.trim(), 0);
+  hot = al.allocate(page);
+  al.deallocate(hot, page);
+  ASSERT_EQ(al.trim(), 0);
+  ASSERT_EQ(al.trim(), 0);
+  ASSERT_EQ(al.trim(), page);
+}
+
+TEST(PoolAlloc, trim_not_mapped) {
+  memory::pool_allocator<uint8_t> al(1 << 16);
+  ASSERT_EQ(al.trim(), 0);
+  memory::pool_options options;
+  options.mapped = true;
+  options.trim_delay = 0;
+  ASSERT_THROW(memory::pool_allocator<uint8_t>(64, options), std::invalid_argument);
+}
+
+TEST(PoolAlloc, warm_up) {
+  memory::pool_allocator<uint8_t> al(1 << 20, 16);
+  uint8_t* p = al.allocate(100);
+  std::fill(p, p + 100, 7);
+
+  memory::pool_warm_up res = al.warm_up(4);
+  ASSERT_EQ(res.bytes, 1 << 20);
+  ASSERT_FALSE(res.locked);
+  ASSERT_EQ(al.last_warm_up().bytes, res.bytes);
+  ASSERT_TRUE(std::all_of(p, p + 100, [](uint8_t b) { return b == 7; }));
+  al.deallocate(p, 100);
+  ASSERT_EQ(al.warm_up(1000).bytes, 1 << 20);
+}
+
+TEST(PoolAlloc, prefault) {
+  std::size_t page = memory::page_storage::page_size();
+  memory::pool_options options;
+  options.mapped = true;
+  options.growable = true;
+  options.prefault = true;
+  options.prefault_threads = 3;
+  memory::pool_allocator<uint8_t> al(5*page, options);
+  ASSERT_EQ(al.last_warm_up().bytes, 5*page);
+  ASSERT_GT(al.last_warm_up().elapsed.count(), 0);
+
+  uint8_t* a = al.allocate(5*page);
+  uint8_t* b = al.allocate(6*page);
+  ASSERT_EQ(al.last_warm_up().bytes, al.remaining() + 6*page);
+  ASSERT_EQ(a[0], 0);
+  ASSERT_EQ(b[6*page - 1], 0);
+  al.deallocate(b, 6*page);
+  al.deallocate(a, 5*page);
+  options.prefault_threads = 0;
+  ASSERT_THROW(memory::pool_allocator<uint8_t>(64, options), std::invalid_argument);
+}
+
+TEST(PoolAlloc, warm_up_lock) {
+  memory::pool_options options;
+  options.block_size = 64;
+  options.prefault = true;
+  options.lock_pages = true;
+  memory::pool_allocator<uint64_t> al(1 << 16, options);
+  // Locking depends on RLIMIT_MEMLOCK, the pool has to work either way
+  uint64_t* p = al.allocate(16);
+  p[15] = 1;
+  al.deallocate(p, 16);
+  memory::pool_warm_up res = al.warm_up(2, true);
+  ASSERT_EQ(res.bytes, 1 << 16);
+  ASSERT_EQ(res.locked, al.last_warm_up().locked);
+}
+
+TEST(PoolAlloc, stats) {
+  memory::pool_options options;
+  options.block_size = 16;
+  options.stats = true;
+  memory::pool_allocator<uint8_t> al(1024, options);
+
+  uint8_t* a = al.allocate(100);
+  uint8_t* b = al.allocate(16);
+  uint8_t* c = al.allocate(300);
+  al.deallocate(b, 16);
+  ASSERT_THROW((void)al.allocate(1024), std::bad_alloc);
+
+  memory::pool_stats stats = al.stats();
+  ASSERT_EQ(stats.allocations, 3);
+  ASSERT_EQ(stats.deallocations, 1);
+  ASSERT_EQ(stats.failures, 1);
+  ASSERT_EQ(stats.high_water, 112 + 16 + 304);
+  ASSERT_EQ(stats.sizes[7], 1);
+  ASSERT_EQ(stats.sizes[5], 1);
+  ASSERT_EQ(stats.sizes[9], 1);
+  ASSERT_EQ(std::accumulate(stats.scans.begin(), stats.scans.end(), std::size_t(0)), 3);
+  ASSERT_EQ(stats.scans[0], 0);
+  ASSERT_EQ(stats.free_bytes, 1024 - 112 - 304);
+  ASSERT_EQ(stats.free_extents, 2);
+  ASSERT_EQ(stats.largest_free, 1024 - 112 - 16 - 304);
+  ASSERT_DOUBLE_EQ(stats.fragmentation, 16.0 / stats.free_bytes);
+  al.deallocate(a, 100);
+  al.deallocate(c, 300);
+  ASSERT_EQ(al.stats().fragmentation, 0);
+  ASSERT_EQ(al.stats().high_water, 432);
+}
+
+TEST(PoolAlloc, stats_scans) {
+  memory::pool_options options;
+  options.block_size = 16;
+  options.stats = true;
+  memory::pool_allocator<uint8_t> al(16*1024, options);
+  // Bucket of the single allocation made since before was taken
+  auto last_bucket = [&](const memory::pool_stats& before) {
+    memory::pool_stats after = al.stats();
+    for (std::size_t i = 0; i < after.scans.size(); ++i) {
+      if (after.scans[i] != before.scans[i]) return i;
+    }
+    return after.scans.size();
+  };
+
+  memory::pool_stats before = al.stats();
+  uint8_t* first = al.allocate(32);
+  std::size_t empty = last_bucket(before);
+  al.deallocate(first, 32);
+
+  std::vector<uint8_t*> ptrs;
+  for (int i = 0; i < 512; ++i) {
+    ptrs.push_back(al.allocate(16));
+  }
+  for (std::size_t i = 0; i < ptrs.size(); i += 2) {
+    al.deallocate(ptrs[i], 16);
+  }
+  // Only single blocks are free among the first 512, the search has to walk
+  // every word covering them
+  before = al.stats();
+  uint8_t* pair = al.allocate(32);
+  ASSERT_GT(last_bucket(before), empty + 2);
+  al.deallocate(pair, 32);
+  for (std::size_t i = 1; i < ptrs.size(); i += 2) {
+    al.deallocate(ptrs[i], 16);
+  }
+}
+
+TEST(PoolAlloc, stats_disabled) {
+  memory::pool_options options;
+  options.growable = true;
+  memory::pool_allocator<uint32_t> al(64, options);
+  uint32_t* a = al.allocate(16);
+  uint32_t* b = al.allocate(16);
+
+  memory::pool_stats stats = al.stats();
+  ASSERT_EQ(stats.allocations, 0);
+  ASSERT_EQ(stats.high_water, 0);
+  ASSERT_EQ(stats.free_extents, 1);
+  ASSERT_EQ(stats.free_bytes, 64);
+  al.deallocate(a, 16);
+  al.deallocate(b, 16);
+  ASSERT_EQ(al.stats().free_extents, 2);
+}
+
+TEST(PoolAlloc, allocate_n) {
+  memory::pool_options options;
+  options.block_size = 16;
+  options.stats = true;
+  memory::pool_allocator<uint32_t> al(1024, options);
+  uint32_t* head = al.allocate(1);
+
+  std::vector<uint32_t*> ptrs(50);
+  al.allocate_n(ptrs.data(), ptrs.size(), 3);
+  ASSERT_EQ(al.allocd(), 51*16);
+  for (std::size_t i = 0; i < ptrs.size(); ++i) {
+    ASSERT_EQ(reinterpret_cast<uint8_t*>(ptrs[i]), reinterpret_cast<uint8_t*>(head) + 16*(i + 1));
+  }
+  ASSERT_EQ(al.stats().allocations, 51);
+  std::vector<uint32_t*> more(14);
+  ASSERT_THROW(al.allocate_n(more.data(), more.size(), 3), std::bad_alloc);
+  ASSERT_EQ(al.allocd(), 51*16);
+  ASSERT_EQ(al.stats().failures, 1);
+  // Blocks taken before the failure are counted and returned
+  ASSERT_EQ(al.stats().allocations, 64);
+  ASSERT_EQ(al.stats().deallocations, 13);
+
+  al.deallocate_n(ptrs.data(), ptrs.size(), 3);
+  ASSERT_EQ(al.stats().deallocations, 63);
+  ASSERT_EQ(al.allocd(), 16);
+  al.deallocate(head, 1);
+  al.allocate_n(ptrs.data(), 0);
+  al.deallocate_n(ptrs.data(), 0);
+}
+
+TEST(PoolAlloc, allocate_n_aligned) {
+  struct alignas(32) wide {
+    char bytes[20];
+  };
+  memory::pool_allocator<wide> al(1024, 16);
+  uint8_t* gap = reinterpret_cast<uint8_t*>(al.allocate(1)) + 32;
+
+  std::vector<wide*> ptrs(20);
+  al.allocate_n(ptrs.data(), ptrs.size());
+  for (wide* p : ptrs) {
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % 32, 0);
+  }
+  ASSERT_EQ(reinterpret_cast<uint8_t*>(ptrs[0]), gap);
+  ASSERT_EQ(al.remaining(), 1024 - 21*32);
+  al.deallocate_n(ptrs.data(), ptrs.size());
+  al.deallocate(reinterpret_cast<wide*>(gap - 32), 1);
+}
+
+TEST(PoolAlloc, allocate_n_growable) {
+  memory::pool_options options;
+  options.block_size = 8;
+  options.growable = true;
+  options.release_empty = true;
+  memory::pool_allocator<uint64_t> al(256, options);
+
+  std::vector<uint64_t*> ptrs(1000);
+  al.allocate_n(ptrs.data(), ptrs.size());
+  ASSERT_EQ(al.allocd(), 8000);
+  ASSERT_GT(al.segments(), 1);
+  std::vector<uint64_t*> sorted(ptrs);
+  std::sort(sorted.begin(), sorted.end());
+  ASSERT_EQ(std::adjacent_find(sorted.begin(), sorted.end()), sorted.end());
+  al.deallocate_n(ptrs.data(), ptrs.size());
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.segments(), 1);
+}
+
+// Frees blocks of two address-adjacent segments in one deallocate_n() call,
+// adjacent is false if the system placed the segments apart
+template <typename Checks>
+void free_adjacent_segments(bool& adjacent) {
+  constexpr std::size_t size = 1 << 16;
+  memory::pool_options options;
+  options.block_size = size;
+  options.growable = true;
+  options.growth_factor = 1;
+  options.mapped = true;
+  memory::pool_allocator<uint8_t, memory::first_fit, Checks> al(size, options);
+  std::array<uint8_t*, 2> ptrs = {al.allocate(size), al.allocate(size)};
+  std::sort(ptrs.begin(), ptrs.end());
+  adjacent = ptrs[0] + size == ptrs[1];
+
+  al.deallocate_n(ptrs.data(), ptrs.size(), size);
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.remaining(), 2*size);
+  al.allocate_n(ptrs.data(), ptrs.size(), size);
+  ASSERT_EQ(al.segments(), 2);
+  al.deallocate_n(ptrs.data(), ptrs.size(), size);
+}
+
+TEST(PoolAlloc, deallocate_n_adjacent_segments) {
+  bool adjacent;
+  free_adjacent_segments<memory::default_checks>(adjacent);
+  free_adjacent_segments<memory::release_checks>(adjacent);
+  if (!adjacent) {
+    GTEST_SKIP() << "Segments were not mapped next to each other";
+  }
+}
+
+TEST(PoolAlloc, try_expand) {
+  memory::pool_options options;
+  options.block_size = 16;
+  options.stats = true;
+  memory::pool_allocator<uint32_t, memory::best_fit> al(256, options);
+  uint32_t* first = al.allocate(4);
+  uint32_t* second = al.allocate(4);
+  ASSERT_FALSE(al.try_expand(first, 4, 5));
+  ASSERT_TRUE(al.try_expand(first, 4, 3));
+  ASSERT_TRUE(al.try_expand(second, 4, 20));
+  ASSERT_EQ(al.allocd(), 96);
+  ASSERT_EQ(al.stats().high_water, 96);
+  ASSERT_FALSE(al.try_expand(second, 20, 61));
+  ASSERT_FALSE(al.try_expand(second, 20, 2));
+  ASSERT_TRUE(al.try_expand(second, 20, 60));
+  ASSERT_EQ(al.remaining(), 0);
+  ASSERT_THROW(al.allocate(1), std::bad_alloc);
+
+  al.deallocate(second, 60);
+  ASSERT_TRUE(al.try_expand(first, 4, 64));
+  al.deallocate(first, 64);
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.largest_free(), 256);
+}
+
+TEST(PoolAlloc, allocate_at_least) {
+  memory::pool_allocator<uint32_t> al(1024, 64);
+  auto res = al.allocate_at_least(5);
+  ASSERT_EQ(res.count, 16);
+  ASSERT_EQ(al.allocd(), 64);
+  auto more = al.allocate_at_least(17);
+  ASSERT_EQ(more.count, 32);
+  al.deallocate(res.ptr, res.count);
+  al.deallocate(more.ptr, 17);
+  ASSERT_EQ(al.allocd(), 0);
+
+  memory::pool_allocator<std::array<uint8_t, 24>> odd(al);
+  auto rounded = odd.allocate_at_least(3);
+  ASSERT_EQ(rounded.count, 5);
+  odd.deallocate(rounded.ptr, rounded.count);
+  ASSERT_EQ(al.allocd(), 0);
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "memory/allocators/pool_bitmap.h"
+
+static std::random_device ran_dev;
+static std::mt19937 gen(ran_dev());
+
+// bit by bit first fit, used as reference
+static std::size_t naive_find(const std::vector<bool>& bits, std::size_t count,
+                              std::size_t from = 0) {
+  std::size_t run = 0;
+  for (std::size_t i = from; i < bits.size(); ++i) {
+    run = bits[i] ? 0 : run + 1;
+    if (run == count) return i + 1 - count;
+  }
+  return memory::pool_bitmap::npos;
+}
+
+TEST(PoolBitmap, init) {
+  constexpr std::size_t size = 130;
+  std::vector<uint64_t> words(memory::pool_bitmap::storage_size(size) / sizeof(uint64_t));
+  memory::pool_bitmap bits(words.data(), size);
+  bits.init();
+
+  ASSERT_EQ(memory::pool_bitmap::word_count(size), 3);
+  ASSERT_TRUE(bits.none());
+  ASSERT_TRUE(bits.none(0, size));
+  ASSERT_FALSE(bits.none(0, size + 1));
+  ASSERT_EQ(bits.find(size), 0);
+  ASSERT_EQ(bits.find(size + 1), memory::pool_bitmap::npos);
+}
+
+TEST(PoolBitmap, set_reset) {
+  constexpr std::size_t size = 256;
+  std::vector<uint64_t> words(memory::pool_bitmap::storage_size(size) / sizeof(uint64_t));
+  memory::pool_bitmap bits(words.data(), size);
+  bits.init();
+
+  bits.set(60, 70);
+  for (std::size_t i = 0; i < size; ++i) {
+    ASSERT_EQ(bits.test(i), i >= 60 && i < 130);
+  }
+  ASSERT_TRUE(bits.all(60, 70));
+  ASSERT_FALSE(bits.all(59, 70));
+  ASSERT_FALSE(bits.none(129, 2));
+  ASSERT_TRUE(bits.none(130, 126));
+
+  bits.reset(64, 64);
+  ASSERT_TRUE(bits.all(60, 4));
+  ASSERT_TRUE(bits.none(64, 64));
+  ASSERT_TRUE(bits.all(128, 2));
+  bits.reset(60, 70);
+  ASSERT_TRUE(bits.none());
+}
+
+TEST(PoolBitmap, find_spanning_words) {
+  constexpr std::size_t size = 64*8;
+  std::vector<uint64_t> words(memory::pool_bitmap::storage_size(size) / sizeof(uint64_t));
+  memory::pool_bitmap bits(words.data(), size);
+  bits.init();
+
+  bits.set(0, 10);
+  bits.set(100, 1);
+  bits.set(300, 1);
+  ASSERT_EQ(bits.find(1), 10);
+  ASSERT_EQ(bits.find(90), 10);
+  ASSERT_EQ(bits.find(91), 101);
+  ASSERT_EQ(bits.find(199), 101);
+  ASSERT_EQ(bits.find(200), 301);
+  ASSERT_EQ(bits.find(201), 301);
+  ASSERT_EQ(bits.find(211), 301);
+  ASSERT_EQ(bits.find(212), memory::pool_bitmap::npos);
+  ASSERT_EQ(bits.find(1, 100), 101);
+}
+
+TEST(PoolBitmap, find_random) {
+  std::uniform_int_distribution<std::size_t> sizes(1, 2000);
+  for (int loop = 0; loop < 50; ++loop) {
+    std::size_t size = sizes(gen);
+    std::vector<uint64_t> words(memory::pool_bitmap::storage_size(size) / sizeof(uint64_t));
+    std::vector<bool> ref(size);
+    memory::pool_bitmap bits(words.data(), size);
+    bits.init();
+
+    std::uniform_int_distribution<std::size_t> pos(0, size - 1);
+    for (int i = 0; i < 20; ++i) {
+      std::size_t first = pos(gen);
+      std::size_t count = std::uniform_int_distribution<std::size_t>(0, size - first)(gen);
+      if (i % 3) {
+        bits.set(first, count);
+      } else {
+        bits.reset(first, count);
+      }
+      for (std::size_t j = first; j < first + count; ++j) ref[j] = i % 3;
+      for (std::size_t want : {std::size_t(1), std::size_t(7), std::size_t(64),
+                               std::size_t(65), size / 3, size}) {
+        if (!want) continue;
+        std::size_t from = pos(gen);
+        ASSERT_EQ(bits.find(want), naive_find(ref, want));
+        ASSERT_EQ(bits.find(want, from), naive_find(ref, want, from));
+      }
+    }
+  }
+}
+
+TEST(PoolBitmap, summary_random) {
+  constexpr std::size_t leaf = memory::pool_bitmap::kLeafBits;
+  std::uniform_int_distribution<std::size_t> sizes(leaf, 9*leaf);
+  for (int loop = 0; loop < 10; ++loop) {
+    std::size_t size = sizes(gen);
+    std::vector<uint64_t> words(memory::pool_bitmap::storage_size(size) / sizeof(uint64_t));
+    std::vector<bool> ref(size);
+    memory::pool_bitmap bits(words.data(), size);
+    bits.init();
+    ASSERT_EQ(bits.longest(), size);
+
+    std::uniform_int_distribution<std::size_t> pos(0, size - 1);
+    std::uniform_int_distribution<std::size_t> len(1, 2*leaf);
+    for (int i = 0; i < 60; ++i) {
+      std::size_t first = pos(gen);
+      std::size_t count = std::min(len(gen), size - first);
+      if (i % 2) {
+        bits.set(first, count);
+      } else {
+        bits.reset(first, count);
+      }
+      for (std::size_t j = first; j < first + count; ++j) ref[j] = i % 2;
+
+      std::size_t longest = 0;
+      std::size_t runs = 0;
+      for (std::size_t j = 0, run = 0; j < size; ++j) {
+        run = ref[j] ? 0 : run + 1;
+        runs += (run == 1);
+        longest = std::max(longest, run);
+      }
+      ASSERT_EQ(bits.longest(), longest);
+      ASSERT_EQ(bits.runs(), runs);
+      ASSERT_EQ(bits.none(), longest == size);
+      std::size_t at = pos(gen);
+      std::size_t run = 0;
+      for (; at + run < size && !ref[at + run]; ++run) {}
+      ASSERT_EQ(bits.run(at), run);
+      ASSERT_EQ(bits.run(at, 70), std::min<std::size_t>(run, 70));
+      for (std::size_t want : {std::size_t(1), std::size_t(100), leaf - 1,
+                               leaf + 1, longest, longest + 1}) {
+        if (!want) continue;
+        std::size_t from = pos(gen);
+        ASSERT_EQ(bits.find(want), naive_find(ref, want));
+        ASSERT_EQ(bits.find(want, from), naive_find(ref, want, from));
+        ASSERT_EQ(memory::pool_bitmap::scan(bits, want, from, size),
+                  naive_find(ref, want, from));
+      }
+    }
+  }
+}
+
+TEST(PoolBitmap, find_aligned_random) {
+  constexpr std::size_t leaf = memory::pool_bitmap::kLeafBits;
+  std::uniform_int_distribution<std::size_t> sizes(1, 3*leaf);
+  for (int loop = 0; loop < 10; ++loop) {
+    std::size_t size = sizes(gen);
+    std::vector<uint64_t> words(memory::pool_bitmap::storage_size(size) / sizeof(uint64_t));
+    std::vector<bool> ref(size);
+    memory::pool_bitmap bits(words.data(), size);
+    bits.init();
+
+    std::uniform_int_distribution<std::size_t> pos(0, size - 1);
+    std::uniform_int_distribution<std::size_t> len(1, 300);
+    for (int i = 0; i < 60; ++i) {
+      std::size_t first = pos(gen);
+      std::size_t count = std::min(len(gen), size - first);
+      if (i % 3) {
+        bits.set(first, count);
+      } else {
+        bits.reset(first, count);
+      }
+      for (std::size_t j = first; j < first + count; ++j) ref[j] = i % 3;
+
+      for (std::size_t align : {2, 8, 64, 512}) {
+        std::size_t phase = pos(gen) % align;
+        std::size_t want = len(gen);
+        std::size_t from = pos(gen);
+        std::size_t expected = memory::pool_bitmap::npos;
+        for (std::size_t p = from; p + want <= size; ++p) {
+          if (p % align != phase) continue;
+          std::size_t j = p;
+          for (; j < p + want && !ref[j]; ++j) {}
+          if (j == p + want) {
+            expected = p;
+            break;
+          }
+        }
+        ASSERT_EQ(bits.find(want, from, align, phase), expected);
+      }
+    }
+  }
+}
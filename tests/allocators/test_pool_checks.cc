@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <type_traits>
+
+#include "memory/allocators/pool_allocator.h"
+#include "memory/containers/vector.h"
+#include "../test_helpers.h"
+
+template <typename T>
+using release_pool = memory::pool_allocator<T, memory::first_fit, memory::release_checks>;
+
+template <typename T>
+using debug_pool = memory::pool_allocator<T, memory::first_fit, memory::debug_checks>;
+
+static_assert(std::is_polymorphic<memory::pool_allocator<int>>::value);
+static_assert(!std::is_nothrow_destructible<memory::pool_allocator<int>>::value);
+static_assert(!std::is_polymorphic<release_pool<int>>::value);
+static_assert(std::is_nothrow_destructible<release_pool<int>>::value);
+static_assert(sizeof(release_pool<int>) == sizeof(void*));
+
+TEST(PoolChecks, release) {
+  memory::pool_options options;
+  options.block_size = 16;
+  options.growable = true;
+  release_pool<subject> al(1024, options);
+  {
+    memory::vector<subject, release_pool<subject>> vec(al);
+    for (int i = 0; i < 200; ++i) {
+      vec.emplace_back(std::to_string(i));
+    }
+    ASSERT_EQ(vec[142], subject("142"));
+  }
+  ASSERT_EQ(al.allocd(), 0);
+
+  // Leaks are not reported
+  ASSERT_NO_THROW(release_pool<int>(64).allocate(1));
+}
+
+TEST(PoolChecks, default_ignores_misuse) {
+  memory::pool_allocator<uint64_t> al(256, 16);
+  uint64_t* ptr = al.allocate(1);
+  uint64_t foreign = 0;
+  al.deallocate(&foreign, 1);
+  al.deallocate(reinterpret_cast<uint64_t*>(reinterpret_cast<uint8_t*>(ptr) + 8), 1);
+  ASSERT_EQ(al.allocd(), 16);
+  al.deallocate(nullptr, 0);
+  al.deallocate(ptr, 1);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolChecks, debug_fill) {
+  debug_pool<uint32_t> al(256, 16);
+  auto* bytes = reinterpret_cast<uint8_t*>(al.allocate(3));
+  // 12 bytes and the guard take two blocks
+  ASSERT_EQ(al.allocd(), 32);
+  for (int i = 0; i < 12; ++i) {
+    ASSERT_EQ(bytes[i], memory::debug_checks::kAllocated);
+  }
+  for (int i = 12; i < 32; ++i) {
+    ASSERT_EQ(bytes[i], memory::debug_checks::kCanary);
+  }
+  al.deallocate(reinterpret_cast<uint32_t*>(bytes), 3);
+  for (int i = 0; i < 32; ++i) {
+    ASSERT_EQ(bytes[i], memory::debug_checks::kReleased);
+  }
+
+  // Guard follows the objects asked for, either count may be freed
+  auto res = al.allocate_at_least(5);
+  ASSERT_EQ(res.count, 6);
+  bytes = reinterpret_cast<uint8_t*>(res.ptr);
+  for (int i = 20; i < 32; ++i) {
+    ASSERT_EQ(bytes[i], memory::debug_checks::kCanary);
+  }
+  al.deallocate(res.ptr, 5);
+  res = al.allocate_at_least(5);
+  al.deallocate(res.ptr, res.count);
+  ASSERT_EQ(al.allocd(), 0);
+
+  res = al.allocate_at_least(5);
+  res.ptr[5] = 1;
+  ASSERT_TRUE(al.try_expand(res.ptr, 6, 12));
+  res.ptr[11] = 1;
+  al.deallocate(res.ptr, 12);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolChecks, debug_with_vector) {
+  debug_pool<subject> al(1 << 14, 16);
+  {
+    memory::vector<subject, debug_pool<subject>> vec(al);
+    for (int i = 0; i < 100; ++i) {
+      vec.emplace_back(std::to_string(i));
+    }
+    vec.shrink_to_fit();
+    ASSERT_EQ(vec[42], subject("42"));
+  }
+  std::vector<subject*> ptrs(20);
+  al.allocate_n(ptrs.data(), ptrs.size(), 2);
+  al.deallocate_n(ptrs.data(), ptrs.size(), 2);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(PoolChecksDeathTest, debug_misuse) {
+  ASSERT_DEATH({
+    debug_pool<uint32_t> al(256, 16);
+    uint32_t* ptr = al.allocate(2);
+    al.deallocate(ptr, 2);
+    al.deallocate(ptr, 2);
+  }, "double free");
+  ASSERT_DEATH({
+    debug_pool<uint32_t> al(256, 16);
+    uint32_t* ptr = al.allocate(2);
+    ptr[2] = 0;
+    al.deallocate(ptr, 2);
+  }, "guard canary");
+  ASSERT_DEATH({
+    debug_pool<uint32_t> al(256, 16);
+    uint32_t* ptr = al.allocate(2);
+    ptr[2] = 0;
+    al.try_expand(ptr, 2, 6);
+  }, "guard canary");
+  ASSERT_DEATH({
+    debug_pool<uint32_t> al(256, 16);
+    uint32_t foreign = 0;
+    al.deallocate(&foreign, 1);
+  }, "not from this pool");
+}
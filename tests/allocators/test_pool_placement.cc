@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "memory/allocators/pool_allocator.h"
+#include "../test_helpers.h"
+
+// Index allocations left until the next one fails, negative never fails
+static int fail_in = -1;
+
+// Index node allocator of best_fit that fails once fail_in reaches zero
+template <typename T>
+struct failing_allocator : std::allocator<T> {
+  template <typename U>
+  struct rebind {
+    using other = failing_allocator<U>;
+  };
+
+  failing_allocator() = default;
+
+  template <typename U>
+  failing_allocator(const failing_allocator<U>&) noexcept {}
+
+  T* allocate(std::size_t count) {
+    if (fail_in >= 0 && fail_in-- == 0) {
+      throw std::bad_alloc();
+    }
+    return std::allocator<T>::allocate(count);
+  }
+};
+
+template <typename Placement>
+class PoolPlacement : public ::testing::Test {};
+
+using placements = ::testing::Types<memory::first_fit, memory::next_fit, memory::best_fit>;
+TYPED_TEST_SUITE(PoolPlacement, placements);
+
+TYPED_TEST(PoolPlacement, alloc_all) {
+  constexpr int64_t size = 1024;
+  memory::pool_allocator<uint8_t, TypeParam> al(size);
+
+  uint8_t* first = al.allocate(size / 2);
+  uint8_t* second = al.allocate(size / 2);
+  ASSERT_EQ(second, first + size / 2);
+  ASSERT_THROW(al.allocate(1), std::bad_alloc);
+  al.deallocate(first, size / 2);
+  al.deallocate(second, size / 2);
+  ASSERT_EQ(al.largest_free(), size);
+  al.deallocate(al.allocate(size), size);
+}
+
+TYPED_TEST(PoolPlacement, alloc_random) {
+  constexpr int64_t size = 1 << 14;
+  memory::pool_allocator<uint8_t, TypeParam> al(size);
+  std::vector<std::pair<uint8_t*, std::size_t>> held;
+  std::mt19937 gen(7);
+
+  for (int i = 0; i < 4000; ++i) {
+    if (held.empty() || gen() % 3) {
+      std::size_t count = 1 + gen() % 200;
+      std::size_t align = std::size_t(1) << (gen() % 7);
+      uint8_t* p;
+      try {
+        p = al.allocate(count, align);
+      } catch (std::bad_alloc&) {
+        continue;
+      }
+      ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % align, 0);
+      held.emplace_back(p, count);
+    } else {
+      std::size_t idx = gen() % held.size();
+      al.deallocate(held[idx].first, held[idx].second);
+      held.erase(held.begin() + idx);
+    }
+  }
+  std::sort(held.begin(), held.end());
+  for (std::size_t i = 1; i < held.size(); ++i) {
+    ASSERT_LE(held[i - 1].first + held[i - 1].second, held[i].first);
+  }
+  for (auto& [p, count] : held) {
+    al.deallocate(p, count);
+  }
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_EQ(al.largest_free(), size);
+}
+
+TYPED_TEST(PoolPlacement, rebind) {
+  constexpr int64_t size = 20*sizeof(subject);
+  memory::pool_allocator<subject, TypeParam> al(size);
+  memory::pool_allocator<uint64_t, TypeParam> al_rebind(al);
+
+  ASSERT_EQ(al, (memory::pool_allocator<subject, TypeParam>(al_rebind)));
+  subject* s = al.allocate(2);
+  uint64_t* u = al_rebind.allocate(3);
+  ASSERT_GE(reinterpret_cast<uint8_t*>(u), reinterpret_cast<uint8_t*>(s + 2));
+  al.deallocate(s, 2);
+  al_rebind.deallocate(u, 3);
+}
+
+TYPED_TEST(PoolPlacement, growable) {
+  memory::pool_options options;
+  options.growable = true;
+  options.release_empty = true;
+  memory::pool_allocator<uint8_t, TypeParam> al(256, options);
+
+  std::vector<uint8_t*> ptrs;
+  for (int i = 0; i < 32; ++i) {
+    ptrs.push_back(al.allocate(64));
+  }
+  ASSERT_GT(al.segments(), 1);
+  for (uint8_t* p : ptrs) {
+    al.deallocate(p, 64);
+  }
+  ASSERT_EQ(al.segments(), 1);
+}
+
+TEST(PoolPlacement, next_fit_roves) {
+  constexpr int64_t size = 1024;
+  memory::pool_allocator<uint8_t, memory::next_fit> al(size);
+
+  uint8_t* first = al.allocate(100);
+  uint8_t* second = al.allocate(100);
+  al.deallocate(first, 100);
+  uint8_t* third = al.allocate(100);
+  ASSERT_EQ(third, second + 100);
+  uint8_t* tail = al.allocate(size - 300);
+  uint8_t* wrapped = al.allocate(100);
+  ASSERT_EQ(wrapped, first);
+  al.deallocate(wrapped, 100);
+  al.deallocate(tail, size - 300);
+  al.deallocate(third, 100);
+  al.deallocate(second, 100);
+}
+
+TEST(PoolPlacement, best_fit_smallest_hole) {
+  constexpr int64_t size = 1024;
+  memory::pool_allocator<uint8_t, memory::best_fit> al(size);
+
+  uint8_t* a = al.allocate(100);
+  uint8_t* b = al.allocate(10);
+  uint8_t* c = al.allocate(40);
+  uint8_t* d = al.allocate(10);
+  al.deallocate(a, 100);
+  al.deallocate(c, 40);
+  ASSERT_EQ(al.allocate(30), c);
+  ASSERT_EQ(al.allocate(10), c + 30);
+  ASSERT_EQ(al.allocate(60), a);
+  al.deallocate(a, 60);
+  al.deallocate(c + 30, 10);
+  al.deallocate(c, 30);
+  al.deallocate(d, 10);
+  al.deallocate(b, 10);
+  ASSERT_EQ(al.largest_free(), size);
+}
+
+TEST(PoolPlacement, best_fit_stale_index) {
+  constexpr int64_t size = 1024;
+  using placement = memory::basic_best_fit<failing_allocator<std::size_t>>;
+  memory::pool_allocator<uint8_t, placement> al(size);
+
+  // The index is rebuilt after a failed update by take() as well as find()
+  uint8_t* a = al.allocate(10);
+  uint8_t* b = al.allocate(100);
+  uint8_t* c = al.allocate(size - 110);
+  fail_in = 0;
+  al.deallocate(b, 100);
+  fail_in = -1;
+  ASSERT_TRUE(al.try_expand(a, 10, 50));
+  ASSERT_EQ(al.largest_free(), 60);
+
+  uint8_t* d = al.allocate(60);
+  ASSERT_EQ(d, a + 50);
+  fail_in = 0;
+  al.deallocate(c, size - 110);
+  fail_in = -1;
+  std::vector<uint8_t*> batch(size - 110);
+  al.allocate_n(batch.data(), batch.size());
+  ASSERT_EQ(batch.front(), c);
+  ASSERT_EQ(al.remaining(), 0);
+  al.deallocate_n(batch.data(), batch.size());
+  al.deallocate(d, 60);
+  al.deallocate(a, 50);
+  ASSERT_EQ(al.largest_free(), size);
+  al.deallocate(al.allocate(size), size);
+}
+
+TYPED_TEST(PoolPlacement, batch) {
+  constexpr std::size_t size = 1 << 12;
+  memory::pool_allocator<uint64_t, TypeParam> al(size, 16);
+  std::vector<uint64_t*> holes(64);
+  al.allocate_n(holes.data(), holes.size());
+  std::vector<uint64_t*> odd;
+  for (std::size_t i = 1; i < holes.size(); i += 2) {
+    odd.push_back(holes[i]);
+  }
+  al.deallocate_n(odd.data(), odd.size());
+
+  std::vector<uint64_t*> batch(100, nullptr);
+  al.allocate_n(batch.data(), batch.size(), 2);
+  ASSERT_EQ(al.allocd(), 32*16 + 100*16);
+  std::vector<uint64_t*> all(batch);
+  for (std::size_t i = 0; i < holes.size(); i += 2) {
+    all.push_back(holes[i]);
+  }
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(std::adjacent_find(all.begin(), all.end()), all.end());
+
+  al.deallocate_n(batch.data(), batch.size(), 2);
+  for (std::size_t i = 0; i < holes.size(); i += 2) {
+    al.deallocate(holes[i], 1);
+  }
+  ASSERT_EQ(al.allocd(), 0);
+  al.deallocate(al.allocate(size / 8), size / 8);
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <list>
+#include <set>
+#include <vector>
+
+#include "memory/allocators/slab_allocator.h"
+#include "memory/containers/vector.h"
+#include "../test_helpers.h"
+
+TEST(SlabAlloc, ctor) {
+  constexpr int64_t size = 1 << 14;
+  memory::slab_allocator<uint8_t> al(size);
+
+  ASSERT_EQ(al.max_size(), size);
+  al.deallocate(al.allocate(size), size);
+  ASSERT_THROW(al.allocate(size + 1), std::bad_alloc);
+}
+
+TEST(SlabAlloc, single_objects) {
+  constexpr int64_t size = 1 << 16;
+  constexpr std::size_t count = 200;
+  memory::slab_allocator<subject> al(size);
+
+  std::set<subject*> ptrs;
+  for (std::size_t i = 0; i < count; ++i) {
+    subject* p = al.allocate(1);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(p) % alignof(subject), 0);
+    ptrs.insert(p);
+  }
+  ASSERT_EQ(ptrs.size(), count);
+  constexpr std::size_t per_slab = memory::slab_state::kSlabBytes / ((sizeof(subject) + 15) / 16 * 16);
+  ASSERT_EQ(al.allocd() % (per_slab*((sizeof(subject) + 15) / 16 * 16)), 0);
+
+  subject* last = *ptrs.rbegin();
+  al.deallocate(last, 1);
+  ASSERT_EQ(al.allocate(1), last);
+  for (subject* p : ptrs) {
+    al.deallocate(p, 1);
+  }
+}
+
+TEST(SlabAlloc, arrays_fall_back) {
+  constexpr int64_t size = 1 << 14;
+  memory::slab_allocator<large> al(size);
+
+  large* array = al.allocate(10);
+  ASSERT_EQ(al.allocd(), 10*sizeof(large) + (16 - 10*sizeof(large) % 16) % 16);
+  al.deallocate(array, 10);
+  ASSERT_EQ(al.allocd(), 0);
+
+  // Small arrays take no slabs either
+  memory::slab_allocator<uint8_t> bytes(al);
+  for (std::size_t count = 2; count <= memory::slab_state::kMaxObject; count *= 2) {
+    uint8_t* p = bytes.allocate(count);
+    ASSERT_EQ(al.allocd(), (count + 15) / 16 * 16);
+    bytes.deallocate(p, count);
+    ASSERT_EQ(al.allocd(), 0);
+  }
+}
+
+TEST(SlabAlloc, exhausted_pool_single_object) {
+  constexpr int64_t size = memory::slab_state::kSlabBytes + 64;
+  memory::slab_allocator<uint64_t> al(size);
+  memory::slab_allocator<std::array<uint8_t, 48>> al_rebind(al);
+
+  uint64_t* first = al.allocate(1);
+  ASSERT_EQ(al.allocd(), memory::slab_state::kSlabBytes);
+  auto* other = al_rebind.allocate(1);
+  ASSERT_EQ(al.allocd(), memory::slab_state::kSlabBytes + 48);
+  ASSERT_THROW(al_rebind.allocate(2), std::bad_alloc);
+  al_rebind.deallocate(other, 1);
+  al.deallocate(first, 1);
+}
+
+TEST(SlabAlloc, with_list) {
+  memory::slab_allocator<int> al(1 << 16);
+  {
+    std::list<int, memory::slab_allocator<int>> list(al);
+    for (int i = 0; i < 500; ++i) list.push_back(i);
+    for (int i = 0; i < 250; ++i) list.pop_front();
+    for (int i = 0; i < 250; ++i) list.push_front(i);
+    ASSERT_EQ(list.size(), 500);
+  }
+}
+
+TEST(SlabAlloc, allocate_at_least) {
+  memory::slab_allocator<std::array<uint8_t, 12>> al(1 << 14);
+  auto small = al.allocate_at_least(3);
+  ASSERT_EQ(small.count, 4);
+  auto same = al.allocate_at_least(4);
+  ASSERT_EQ(same.ptr, small.ptr + 4);
+  al.deallocate(small.ptr, small.count);
+  ASSERT_EQ(al.allocate(4), small.ptr);
+  al.deallocate(small.ptr, 4);
+  al.deallocate(same.ptr, same.count);
+
+  std::size_t allocd = al.allocd();
+  auto large = al.allocate_at_least(30);
+  ASSERT_EQ(large.count, (al.allocd() - allocd) / 12);
+  ASSERT_GE(large.count, 30);
+  al.deallocate(large.ptr, large.count);
+  ASSERT_EQ(al.allocd(), allocd);
+}
+
+TEST(SlabAlloc, with_vector) {
+  memory::slab_allocator<subject> al(1 << 16);
+  memory::vector<subject, memory::slab_allocator<subject>> vec(al);
+  for (int i = 0; i < 100; ++i) {
+    vec.emplace_back(std::to_string(i));
+  }
+  ASSERT_EQ(vec[42], subject("42"));
+}
+
+TEST(SlabAlloc, alloc_leak) {
+  bool passed = false;
+  try {
+    memory::slab_allocator<subject> al(1 << 14);
+    al.allocate(1);
+  } catch (std::runtime_error& e) {
+    passed = true;
+  }
+  ASSERT_TRUE(passed);
+}
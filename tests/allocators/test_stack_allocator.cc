@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include "memory/allocators/stack_allocator.h"
+#include "memory/containers/vector.h"
+#include "../test_helpers.h"
+
+TEST(StackAlloc, ctor) {
+  constexpr int64_t size = 1024;
+  memory::stack_allocator<uint8_t> al(size);
+
+  ASSERT_EQ(al.max_size(), size);
+  ASSERT_EQ(al.remaining(), size);
+  al.deallocate(al.allocate(size), size);
+  ASSERT_EQ(al.allocd(), 0);
+  ASSERT_THROW(al.allocate(size + 1), std::bad_alloc);
+  ASSERT_THROW(memory::stack_allocator<uint8_t>(0), std::bad_alloc);
+}
+
+TEST(StackAlloc, lifo) {
+  constexpr int64_t size = 1024;
+  memory::stack_allocator<uint8_t> al(size);
+
+  uint8_t* a = al.allocate(10);
+  uint8_t* b = al.allocate(20);
+  ASSERT_EQ(b, a + 10);
+  al.deallocate(a, 10);
+  ASSERT_EQ(al.allocd(), 30);
+  al.deallocate(b, 20);
+  ASSERT_EQ(al.allocd(), 10);
+  ASSERT_EQ(al.allocate(5), a + 10);
+}
+
+TEST(StackAlloc, alloc_aligned) {
+  constexpr int64_t size = 1024;
+  memory::stack_allocator<uint8_t> al(size);
+
+  uint8_t* a = al.allocate(3);
+  uint64_t* b = memory::stack_allocator<uint64_t>(al).allocate(2);
+  ASSERT_EQ(reinterpret_cast<uint8_t*>(b), a + 8);
+  uint8_t* c = al.allocate(1, 256);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(c) % 256, 0);
+  ASSERT_THROW(al.allocate(1, 3), std::invalid_argument);
+  ASSERT_THROW(al.allocate(al.remaining(), 128), std::bad_alloc);
+}
+
+TEST(StackAlloc, mark_rewind) {
+  constexpr int64_t size = 1024;
+  memory::stack_allocator<uint8_t> al(size);
+  memory::stack_allocator<subject> al_rebind(al);
+
+  uint8_t* base = al.allocate(100);
+  auto outer = al.mark();
+  al.allocate(200);
+  auto inner = al_rebind.mark();
+  al_rebind.allocate(4);
+  al.rewind(inner);
+  ASSERT_EQ(al.allocd(), 300);
+  al_rebind.rewind(outer);
+  ASSERT_EQ(al.allocd(), 100);
+  al.rewind(inner);
+  ASSERT_EQ(al.allocd(), 100);
+  ASSERT_EQ(al.allocate(1), base + 100);
+  al.rewind(memory::stack_marker());
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(StackAlloc, scope) {
+  constexpr int64_t size = 1024;
+  memory::stack_allocator<uint8_t> al(size);
+
+  al.allocate(10);
+  {
+    memory::stack_allocator<uint8_t>::scope guard(al);
+    al.allocate(500);
+    {
+      memory::stack_allocator<uint8_t>::scope nested(al);
+      al.allocate(500);
+      ASSERT_THROW(al.allocate(100), std::bad_alloc);
+    }
+    ASSERT_EQ(al.allocd(), 510);
+  }
+  ASSERT_EQ(al.allocd(), 10);
+}
+
+TEST(StackAlloc, swap) {
+  memory::stack_allocator<subject> lhs(1024);
+  memory::stack_allocator<subject> rhs(2048);
+  memory::stack_allocator<subject> lhs_cpy(lhs);
+  memory::stack_allocator<subject> rhs_cpy(rhs);
+
+  using std::swap;
+  swap(lhs, rhs);
+  ASSERT_EQ(rhs, lhs_cpy);
+  ASSERT_EQ(lhs, rhs_cpy);
+}
+
+TEST(StackAlloc, try_expand) {
+  memory::stack_allocator<uint32_t> al(256);
+  uint32_t* first = al.allocate(4);
+  ASSERT_TRUE(al.try_expand(first, 4, 8));
+  ASSERT_EQ(al.allocd(), 32);
+  uint32_t* second = al.allocate(4);
+  ASSERT_FALSE(al.try_expand(first, 8, 16));
+  ASSERT_FALSE(al.try_expand(second, 4, 61));
+  ASSERT_TRUE(al.try_expand(second, 4, 56));
+  ASSERT_EQ(al.remaining(), 0);
+  al.deallocate(second, 56);
+  al.deallocate(first, 8);
+  ASSERT_EQ(al.allocd(), 0);
+}
+
+TEST(StackAlloc, with_vector) {
+  memory::stack_allocator<subject> al(1 << 16);
+  {
+    memory::stack_allocator<subject>::scope guard(al);
+    memory::vector<subject, memory::stack_allocator<subject>> vec(al);
+    for (int i = 0; i < 100; ++i) {
+      vec.emplace_back(std::to_string(i));
+    }
+    ASSERT_EQ(vec[42], subject("42"));
+  }
+  ASSERT_EQ(al.allocd(), 0);
+}
@@ -1891,6 +1891,45 @@ TEST(VectorTest, stream) {
   EXPECT_EQ(expected, stream.str());
 }
 
+TEST(VectorTest, grow_in_place) {
+  memory::pool_allocator<int> al(4096, 8);
+  memory::vector<int, memory::pool_allocator<int>> vec(al);
+  vec.push_back(0);
+  const int* data = vec.data();
+  for (int i = 1; i < 100; ++i) {
+    vec.push_back(i);
+  }
+  ASSERT_EQ(vec.data(), data);
+  vec.reserve(200);
+  vec.resize(150, 7);
+  ASSERT_EQ(vec.data(), data);
+  ASSERT_EQ(vec.capacity(), 200);
+  ASSERT_EQ(vec[99], 99);
+  ASSERT_EQ(vec[149], 7);
+
+  int* blocker = al.allocate(1);
+  vec.resize(201);
+  ASSERT_NE(vec.data(), data);
+  ASSERT_EQ(vec[99], 99);
+  al.deallocate(blocker, 1);
+}
+
+TEST(VectorTest, allocate_at_least) {
+  memory::pool_allocator<int> al(4096, 64);
+  memory::vector<int, memory::pool_allocator<int>> vec(al);
+  vec.push_back(0);
+  ASSERT_EQ(vec.capacity(), 16);
+  int* blocker = al.allocate(1);
+  for (int i = 1; i < 17; ++i) {
+    vec.push_back(i);
+  }
+  ASSERT_EQ(vec.capacity(), 48);
+  vec.shrink_to_fit();
+  ASSERT_EQ(vec.capacity(), 32);
+  ASSERT_EQ(vec[16], 16);
+  al.deallocate(blocker, 1);
+}
+
 #if __cplusplus >= 202002L
 TEST(VectorTest, valid_constexpr) {
   constexpr std::size_t cexper = constexpr_check(0);
@@ -0,0 +1,372 @@
+// Replays an allocation trace written by memory::event_recorder against one
+// allocator and reports throughput, latency percentiles, peak RSS growth and
+// fragmentation. Run it once per allocator, peak RSS is per process.
+//
+// Throughput is operations over wall-clock time of the whole replay loop,
+// bookkeeping of the tool included. RSS growth is the rise of the process
+// peak RSS over the replay, after the trace is loaded and buffers are
+// reserved; map nodes of live blocks still count towards it.
+//
+//   alloc_replay <trace> [--allocator pool|slab|buddy|arena|malloc] [--size bytes]
+//
+// Events are replayed on one thread in timestamp order. Blocks are matched by
+// pool id and offset; deallocations without a matching allocation and
+// container reallocation events are skipped. --size sets the pool size of
+// pool, slab and buddy, by default twice the peak live size of the trace, so
+// footprint of those is fixed; pool grows beyond it when fragmented.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>  // getrusage
+#endif
+
+#include "memory/allocators/buddy_allocator.h"
+#include "memory/allocators/event_recorder.h"
+#include "memory/allocators/monotonic_allocator.h"
+#include "memory/allocators/pool_allocator.h"
+#include "memory/allocators/slab_allocator.h"
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+// Allocator under test, sizes are in bytes
+class target {
+ public:
+  virtual ~target() = default;
+  virtual uint8_t* allocate(std::size_t size) = 0;
+  virtual void deallocate(uint8_t* ptr, std::size_t size) = 0;
+  // Bytes the allocator holds, zero if unknown
+  virtual std::size_t footprint() const { return 0; }
+  // External fragmentation of free space, negative if unknown. Sampled at
+  // every new peak of live bytes, outside of timed calls.
+  virtual double fragmentation() const { return -1; }
+};
+
+// Library allocators reporting allocd() and remaining()
+template <typename Allocator>
+class allocator_target : public target {
+ public:
+  explicit allocator_target(const Allocator& al) : al_(al) {}
+
+  // Every block is returned before the target is destroyed
+  ~allocator_target() noexcept override {}
+
+  uint8_t* allocate(std::size_t size) override {
+    return al_.allocate(size);
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t size) override {
+    al_.deallocate(ptr, size);
+  }
+
+  std::size_t footprint() const override {
+    return al_.allocd() + al_.remaining();
+  }
+
+ protected:
+  Allocator al_;
+};
+
+class pool_target : public allocator_target<memory::pool_allocator<uint8_t>> {
+ public:
+  using allocator_target::allocator_target;
+
+  double fragmentation() const override {
+    return al_.stats().fragmentation;
+  }
+};
+
+// Slabs serve single objects only, so every block is allocated as one
+// object of its size
+class slab_target : public allocator_target<memory::slab_allocator<uint8_t>> {
+ public:
+  using allocator_target::allocator_target;
+
+  uint8_t* allocate(std::size_t size) override {
+    return static_cast<uint8_t*>(al_.allocate_bytes(size, alignof(std::max_align_t)));
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t size) override {
+    al_.deallocate_bytes(ptr, size, alignof(std::max_align_t));
+  }
+};
+
+class arena_target : public target {
+ public:
+  uint8_t* allocate(std::size_t size) override {
+    return al_.allocate(size, alignof(std::max_align_t));
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t size) override {
+    al_.deallocate(ptr, size);
+  }
+
+ private:
+  memory::monotonic_allocator<uint8_t> al_;
+};
+
+class malloc_target : public target {
+ public:
+  uint8_t* allocate(std::size_t size) override {
+    void* res = std::malloc(size ? size : 1);
+    if (!res) {
+      throw std::bad_alloc();
+    }
+    return static_cast<uint8_t*>(res);
+  }
+
+  void deallocate(uint8_t* ptr, std::size_t) override {
+    std::free(ptr);
+  }
+};
+
+struct block_key {
+  uint64_t offset;
+  uint16_t source;
+
+  bool operator==(const block_key& other) const noexcept {
+    return offset == other.offset && source == other.source;
+  }
+};
+
+struct block_hash {
+  std::size_t operator()(const block_key& key) const noexcept {
+    return std::hash<uint64_t>()(key.offset * 0x9e3779b97f4a7c15ull ^ key.source);
+  }
+};
+
+struct block {
+  uint8_t* ptr;
+  std::size_t size;
+};
+
+struct result {
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+  std::size_t failed = 0;
+  std::size_t skipped = 0;
+  std::vector<uint64_t> latencies;
+  // Wall-clock time of the replay
+  uint64_t wall = 0;
+  // Peak RSS of the process before and after the replay
+  std::size_t rss_before = 0;
+  std::size_t rss_after = 0;
+  std::size_t peak_live = 0;
+  std::size_t peak_footprint = 0;
+  double fragmentation = -1;
+};
+
+uint64_t elapsed(clock_type::time_point start, clock_type::time_point stop) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+}
+
+std::vector<memory::alloc_event> sorted_events(const char* path) {
+  std::vector<memory::alloc_event> events = memory::event_recorder::load(path);
+  std::stable_sort(events.begin(), events.end(),
+      [](const memory::alloc_event& lhs, const memory::alloc_event& rhs) {
+        return lhs.time < rhs.time;
+      });
+  return events;
+}
+
+// Highest number of bytes live at once
+std::size_t peak_live(const std::vector<memory::alloc_event>& events) {
+  std::unordered_map<block_key, std::size_t, block_hash> live;
+  std::size_t bytes = 0;
+  std::size_t res = 0;
+  for (const memory::alloc_event& e : events) {
+    block_key key{e.offset, e.source};
+    if (e.kind == memory::alloc_event::kAllocate && live.emplace(key, e.size).second) {
+      bytes += e.size;
+      res = std::max(res, bytes);
+    } else if (e.kind == memory::alloc_event::kDeallocate) {
+      auto it = live.find(key);
+      if (it != live.end()) {
+        bytes -= it->second;
+        live.erase(it);
+      }
+    }
+  }
+  return res;
+}
+
+// Peak resident set size of the process in bytes, zero if unknown
+std::size_t peak_rss() {
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage;
+  if (!getrusage(RUSAGE_SELF, &usage)) {
+#if defined(__APPLE__)
+    return usage.ru_maxrss;
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+  }
+#endif
+  return 0;
+}
+
+result replay(const std::vector<memory::alloc_event>& events, target& alloc) {
+  result res;
+  res.latencies.reserve(events.size());
+  std::unordered_map<block_key, block, block_hash> live;
+  live.reserve(events.size() / 2);
+  std::size_t live_bytes = 0;
+  res.rss_before = peak_rss();
+  auto begin = clock_type::now();
+  for (const memory::alloc_event& e : events) {
+    block_key key{e.offset, e.source};
+    if (e.kind == memory::alloc_event::kAllocate) {
+      if (live.count(key)) {
+        ++res.skipped;
+        continue;
+      }
+      uint8_t* ptr;
+      auto start = clock_type::now();
+      try {
+        ptr = alloc.allocate(e.size);
+      } catch (const std::bad_alloc&) {
+        ++res.failed;
+        continue;
+      }
+      auto stop = clock_type::now();
+      res.latencies.push_back(elapsed(start, stop));
+      ++res.allocations;
+      // Touch the block so that peak RSS reflects the allocator layout
+      std::memset(ptr, 0xa5, e.size);
+      live.emplace(key, block{ptr, e.size});
+      live_bytes += e.size;
+      if (live_bytes > res.peak_live) {
+        res.peak_live = live_bytes;
+        res.peak_footprint = std::max(res.peak_footprint, alloc.footprint());
+        res.fragmentation = alloc.fragmentation();
+      }
+    } else if (e.kind == memory::alloc_event::kDeallocate) {
+      auto it = live.find(key);
+      if (it == live.end()) {
+        ++res.skipped;
+        continue;
+      }
+      auto start = clock_type::now();
+      alloc.deallocate(it->second.ptr, it->second.size);
+      auto stop = clock_type::now();
+      res.latencies.push_back(elapsed(start, stop));
+      ++res.deallocations;
+      live_bytes -= it->second.size;
+      live.erase(it);
+    } else {
+      ++res.skipped;
+    }
+  }
+  res.wall = elapsed(begin, clock_type::now());
+  res.rss_after = peak_rss();
+  for (auto& [key, b] : live) {
+    alloc.deallocate(b.ptr, b.size);
+  }
+  return res;
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[static_cast<std::size_t>(p * (sorted.size() - 1))];
+}
+
+void report(const std::string& name, const result& res) {
+  std::vector<uint64_t> sorted = res.latencies;
+  std::sort(sorted.begin(), sorted.end());
+  std::printf("allocator:          %s\n", name.c_str());
+  std::printf("allocations:        %zu\n", res.allocations);
+  std::printf("deallocations:      %zu\n", res.deallocations);
+  std::printf("failed:             %zu\n", res.failed);
+  std::printf("skipped:            %zu\n", res.skipped);
+  std::printf("throughput (wall):  %.0f ops/s\n",
+              res.wall ? sorted.size() * 1e9 / res.wall : 0.0);
+  std::printf("latency p50:        %llu ns\n", (unsigned long long)percentile(sorted, 0.5));
+  std::printf("latency p90:        %llu ns\n", (unsigned long long)percentile(sorted, 0.9));
+  std::printf("latency p99:        %llu ns\n", (unsigned long long)percentile(sorted, 0.99));
+  std::printf("latency p99.9:      %llu ns\n", (unsigned long long)percentile(sorted, 0.999));
+  std::printf("latency max:        %llu ns\n", (unsigned long long)percentile(sorted, 1));
+  std::printf("peak live:          %zu bytes\n", res.peak_live);
+  std::printf("peak RSS growth:    %zu bytes\n", res.rss_after - res.rss_before);
+  if (res.peak_footprint) {
+    std::printf("peak footprint:     %zu bytes\n", res.peak_footprint);
+    std::printf("overhead at peak:   %.3f\n", 1 - double(res.peak_live) / res.peak_footprint);
+  }
+  if (res.fragmentation >= 0) {
+    std::printf("peak fragmentation: %.3f\n", res.fragmentation);
+  }
+}
+
+std::unique_ptr<target> make_target(const std::string& name, std::size_t size) {
+  if (name == "pool") {
+    memory::pool_options options;
+    options.block_size = 16;
+    options.growable = true;
+    return std::make_unique<pool_target>(memory::pool_allocator<uint8_t>(size, options));
+  } else if (name == "slab") {
+    return std::make_unique<slab_target>(memory::slab_allocator<uint8_t>(size));
+  } else if (name == "buddy") {
+    return std::make_unique<allocator_target<memory::buddy_allocator<uint8_t>>>(
+        memory::buddy_allocator<uint8_t>(size));
+  } else if (name == "arena") {
+    return std::make_unique<arena_target>();
+  } else if (name == "malloc") {
+    return std::make_unique<malloc_target>();
+  }
+  return nullptr;
+}
+
+int usage() {
+  std::fprintf(stderr, "usage: alloc_replay <trace> "
+                       "[--allocator pool|slab|buddy|arena|malloc] [--size bytes]\n");
+  return 1;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* path = nullptr;
+  std::string name = "pool";
+  std::size_t size = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--allocator" && i + 1 < argc) {
+      name = argv[++i];
+    } else if (arg == "--size" && i + 1 < argc) {
+      size = std::strtoull(argv[++i], nullptr, 10);
+    } else if (!path && arg[0] != '-') {
+      path = argv[i];
+    } else {
+      return usage();
+    }
+  }
+  if (!path) {
+    return usage();
+  }
+  try {
+    std::vector<memory::alloc_event> events = sorted_events(path);
+    if (!size) {
+      size = std::max<std::size_t>(2*peak_live(events), 1 << 20);
+    }
+    std::unique_ptr<target> alloc = make_target(name, size);
+    if (!alloc) {
+      return usage();
+    }
+    report(name, replay(events, *alloc));
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "alloc_replay: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}